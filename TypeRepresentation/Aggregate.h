@@ -0,0 +1,334 @@
+#pragma once
+
+#include "Types.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace Types
+{
+    //Field value interpreted according to its primitive.
+    struct Number
+    {
+        enum Kind
+        {
+            Signed,
+            Unsigned,
+            Real
+        };
+
+        Kind kind = Unsigned;
+        long long s = 0;
+        unsigned long long u = 0;
+        double d = 0;
+
+        double AsDouble() const
+        {
+            return kind == Signed ? double(s) : kind == Unsigned ? double(u) : d;
+        }
+    };
+
+    struct AggregateOptions
+    {
+        int buckets = 0; //Number of histogram buckets (0 disables the histogram)
+        double histogramMin = 0; //Lower bound of the first bucket
+        double histogramMax = 0; //Upper bound of the last bucket
+        bool distinct = false; //Count distinct values (needs count * 8 bytes)
+        int threads = 0; //Worker threads (0 = hardware concurrency)
+    };
+
+    struct Aggregation
+    {
+        Field field; //Aggregated field
+        size_t count = 0; //Number of aggregated values
+        size_t nan = 0; //NaN values of float fields, left out of count and all other results
+        Number min;
+        Number max;
+        Number sum; //Integer sums are accumulated in 64 bits
+        std::vector<size_t> histogram; //AggregateOptions::buckets counts
+        size_t below = 0; //Values below histogramMin
+        size_t above = 0; //Values at or above histogramMax
+        size_t distinct = 0; //Number of distinct values (if requested)
+    };
+
+    //min/max/sum/histogram/distinct of a single field over count consecutive instances.
+    struct Aggregator
+    {
+        //stride defaults to the size of the type (a plain array of instances)
+        static bool Run(TypeManager & t, const std::string & type, const std::string & path, const void* base, size_t count, Aggregation & result, const AggregateOptions & options = AggregateOptions(), size_t stride = 0)
+        {
+            result = Aggregation();
+            auto layout = t.GetLayout(type);
+            if (!layout || !base)
+                return false;
+            auto field = layout->FindField(path);
+            if (!field || field->bitsize) //bitfields go through ColumnExporter
+                return false;
+            if (!stride)
+                stride = size_t(layout->size);
+            result.field = *field;
+            if (options.buckets < 0 || (options.buckets && !(options.histogramMax > options.histogramMin)))
+                return false;
+
+            auto src = (const unsigned char*)base + field->offset;
+            switch (field->primitive)
+            {
+            case Float:
+                return run<float, double>(Number::Real, src, stride, count, options, result);
+            case Double:
+                return run<double, double>(Number::Real, src, stride, count, options, result);
+            case Int8:
+            case Int16:
+            case Int32:
+            case Int64:
+            case Dsint:
+                switch (field->size)
+                {
+                case 1:
+                    return run<signed char, long long>(Number::Signed, src, stride, count, options, result);
+                case 2:
+                    return run<short, long long>(Number::Signed, src, stride, count, options, result);
+                case 4:
+                    return run<int, long long>(Number::Signed, src, stride, count, options, result);
+                case 8:
+                    return run<long long, long long>(Number::Signed, src, stride, count, options, result);
+                }
+                return false;
+            default:
+                switch (field->size)
+                {
+                case 1:
+                    return run<unsigned char, unsigned long long>(Number::Unsigned, src, stride, count, options, result);
+                case 2:
+                    return run<unsigned short, unsigned long long>(Number::Unsigned, src, stride, count, options, result);
+                case 4:
+                    return run<unsigned int, unsigned long long>(Number::Unsigned, src, stride, count, options, result);
+                case 8:
+                    return run<unsigned long long, unsigned long long>(Number::Unsigned, src, stride, count, options, result);
+                }
+                return false;
+            }
+        }
+
+    private:
+        //Integer sums are accumulated in unsigned 64 bits (wrapping is defined, signed overflow is not) and
+        //converted back when the result is built
+        template<typename A>
+        struct Accumulator
+        {
+            typedef typename std::conditional<std::is_integral<A>::value, unsigned long long, A>::type Type;
+        };
+
+        template<typename A>
+        struct Partial
+        {
+            size_t count = 0;
+            size_t nan = 0;
+            A min = A();
+            A max = A();
+            typename Accumulator<A>::Type sum = 0;
+            std::vector<size_t> histogram;
+            size_t below = 0;
+            size_t above = 0;
+            std::vector<A> values;
+        };
+
+        template<typename T>
+        static T load(const unsigned char* src)
+        {
+            T value;
+            memcpy(&value, src, sizeof(T));
+            return value;
+        }
+
+        //Always false for integers
+        template<typename A>
+        static bool isNan(A v)
+        {
+            return v != v;
+        }
+
+        template<typename T, typename A>
+        static void scan(const unsigned char* src, size_t stride, size_t count, Partial<A> & p)
+        {
+            //min/max start from the first value that is not NaN, later NaNs fail both comparisons and add nothing
+            size_t i = 0;
+            while (i < count && isNan(A(load<T>(src))))
+            {
+                i++;
+                src += stride;
+            }
+            p.nan = i;
+            p.count = count - i;
+            if (i == count)
+                return;
+            //unrolled by four into independent scalar accumulators, so consecutive strided loads do not wait on
+            //one dependency chain (the loads are strided, the loop is not vectorized)
+            typedef typename Accumulator<A>::Type S;
+            A min[4], max[4];
+            S sum[4];
+            size_t nan[4] = { 0, 0, 0, 0 };
+            for (auto j = 0; j < 4; j++)
+            {
+                min[j] = max[j] = A(load<T>(src));
+                sum[j] = 0;
+            }
+            for (; i + 4 <= count; i += 4, src += stride * 4)
+            {
+                for (auto j = 0; j < 4; j++)
+                {
+                    auto v = A(load<T>(src + stride * j));
+                    auto skip = isNan(v);
+                    min[j] = v < min[j] ? v : min[j];
+                    max[j] = v > max[j] ? v : max[j];
+                    sum[j] += skip ? S(0) : S(v);
+                    nan[j] += skip;
+                }
+            }
+            for (; i < count; i++, src += stride)
+            {
+                auto v = A(load<T>(src));
+                auto skip = isNan(v);
+                min[0] = v < min[0] ? v : min[0];
+                max[0] = v > max[0] ? v : max[0];
+                sum[0] += skip ? S(0) : S(v);
+                nan[0] += skip;
+            }
+            auto nans = (nan[0] + nan[1]) + (nan[2] + nan[3]);
+            p.nan += nans;
+            p.count -= nans;
+            p.min = std::min(std::min(min[0], min[1]), std::min(min[2], min[3]));
+            p.max = std::max(std::max(max[0], max[1]), std::max(max[2], max[3]));
+            p.sum = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+        }
+
+        template<typename T, typename A>
+        static void collect(const unsigned char* src, size_t stride, size_t count, const AggregateOptions & options, Partial<A> & p)
+        {
+            if (options.buckets)
+            {
+                p.histogram.assign(size_t(options.buckets), 0);
+                auto scale = options.buckets / (options.histogramMax - options.histogramMin);
+                auto s = src;
+                for (size_t i = 0; i < count; i++, s += stride)
+                {
+                    auto v = double(load<T>(s));
+                    if (isNan(v))
+                        continue;
+                    if (v < options.histogramMin)
+                        p.below++;
+                    else if (v >= options.histogramMax)
+                        p.above++;
+                    else
+                    {
+                        auto bucket = size_t((v - options.histogramMin) * scale);
+                        p.histogram[bucket < p.histogram.size() ? bucket : p.histogram.size() - 1]++;
+                    }
+                }
+            }
+            if (options.distinct)
+            {
+                p.values.reserve(count - p.nan);
+                auto s = src;
+                for (size_t i = 0; i < count; i++, s += stride)
+                {
+                    auto v = A(load<T>(s));
+                    if (!isNan(v)) //NaN would break the ordering sort and unique rely on
+                        p.values.push_back(v);
+                }
+                std::sort(p.values.begin(), p.values.end());
+                p.values.erase(std::unique(p.values.begin(), p.values.end()), p.values.end());
+            }
+        }
+
+        template<typename T, typename A>
+        static void work(const unsigned char* src, size_t stride, size_t count, const AggregateOptions & options, Partial<A> & p)
+        {
+            scan<T, A>(src, stride, count, p);
+            collect<T, A>(src, stride, count, options, p);
+        }
+
+        template<typename T, typename A>
+        static bool run(Number::Kind kind, const unsigned char* src, size_t stride, size_t count, const AggregateOptions & options, Aggregation & result)
+        {
+            const size_t minPerThread = 1 << 16;
+            size_t threads = options.threads > 0 ? size_t(options.threads) : size_t(std::thread::hardware_concurrency());
+            if (!threads)
+                threads = 1;
+            if (threads > count / minPerThread)
+                threads = count / minPerThread ? count / minPerThread : 1;
+
+            std::vector<Partial<A>> partials(threads);
+            auto chunk = count / threads;
+            if (threads == 1)
+                work<T, A>(src, stride, count, options, partials[0]);
+            else
+            {
+                std::vector<std::thread> workers;
+                for (size_t i = 0; i < threads; i++)
+                {
+                    auto first = i * chunk;
+                    auto n = i + 1 == threads ? count - first : chunk;
+                    auto & p = partials[i];
+                    workers.push_back(std::thread([src, stride, first, n, &options, &p]()
+                    {
+                        work<T, A>(src + first * stride, stride, n, options, p);
+                    }));
+                }
+                for (auto & w : workers)
+                    w.join();
+            }
+
+            auto total = partials[0];
+            std::vector<A> values;
+            values.swap(total.values);
+            for (size_t i = 1; i < partials.size(); i++)
+            {
+                const auto & p = partials[i];
+                total.nan += p.nan;
+                if (!p.count)
+                    continue;
+                total.min = total.count && total.min < p.min ? total.min : p.min;
+                total.max = total.count && total.max > p.max ? total.max : p.max;
+                total.sum += p.sum;
+                total.count += p.count;
+                for (size_t j = 0; j < total.histogram.size(); j++)
+                    total.histogram[j] += p.histogram[j];
+                total.below += p.below;
+                total.above += p.above;
+                values.insert(values.end(), p.values.begin(), p.values.end());
+            }
+            if (options.distinct && partials.size() > 1)
+            {
+                std::sort(values.begin(), values.end());
+                values.erase(std::unique(values.begin(), values.end()), values.end());
+            }
+
+            result.count = total.count;
+            result.nan = total.nan;
+            result.min = number(kind, total.min);
+            result.max = number(kind, total.max);
+            result.sum = number(kind, total.sum);
+            result.histogram.swap(total.histogram);
+            result.below = total.below;
+            result.above = total.above;
+            result.distinct = values.size();
+            return true;
+        }
+
+        template<typename A>
+        static Number number(Number::Kind kind, A value)
+        {
+            Number n;
+            n.kind = kind;
+            if (kind == Number::Signed)
+                n.s = (long long)value;
+            else if (kind == Number::Unsigned)
+                n.u = (unsigned long long)value;
+            else
+                n.d = double(value);
+            return n;
+        }
+    };
+};
\ No newline at end of file
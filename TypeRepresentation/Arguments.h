@@ -0,0 +1,330 @@
+#pragma once
+
+#include "Types.h"
+#include <cstring>
+
+namespace Types
+{
+    //Register snapshot at function entry (32-bit code uses the low halves: Eax, Ecx, Edx, ...)
+    struct Registers
+    {
+        enum Gpr
+        {
+            Rax,
+            Rcx,
+            Rdx,
+            Rbx,
+            Rsp,
+            Rbp,
+            Rsi,
+            Rdi,
+            R8,
+            R9,
+            R10,
+            R11,
+            R12,
+            R13,
+            R14,
+            R15
+        };
+
+        unsigned long long gpr[16]; //General purpose registers in encoding order
+        unsigned long long xmm[16]; //Low 64 bits of the vector registers
+    };
+
+    //Where (part of) an argument lives at function entry
+    struct ArgLocation
+    {
+        enum Kind
+        {
+            Register, //Registers::gpr[reg]
+            FloatRegister, //Registers::xmm[reg]
+            Stack //offset bytes above the first stack argument (just above the return address)
+        };
+
+        int arg = -1; //Index in Function::args, -1 for the hidden return buffer pointer
+        Kind kind = Stack;
+        int reg = 0; //Register index (Register/FloatRegister)
+        int offset = 0; //Stack offset (Stack)
+        int part = 0; //Offset of this part in the argument (System V passes aggregates in up to two registers)
+        int size = 0; //Size of this part in bytes
+        bool reference = false; //The decoded value is the address of the argument instead of its value. Stack
+                                //locations over 8 bytes hold the argument itself, smaller ones hold its address.
+    };
+
+    struct ArgumentPlan
+    {
+        std::string function; //Function identifier
+        CallingConvention callconv = Cdecl;
+        std::vector<ArgLocation> locations; //One per decoded value, in argument order
+        int stackSize = 0; //Bytes of stack arguments above the return address
+        int returnSize = 0; //Bytes of the return address (the entry stack pointer plus returnSize is stack offset 0)
+        bool calleeCleanup = false; //The callee pops stackSize bytes (stdcall, thiscall, delphi)
+    };
+
+    //Computes argument locations once per function, then decodes them at every call without allocating.
+    struct ArgumentLayout
+    {
+        static bool Plan(TypeManager & t, const std::string & function, ArgumentPlan & plan)
+        {
+            plan = ArgumentPlan();
+            auto f = t.FindFunction(function);
+            if (!f)
+                return false;
+            plan.function = function;
+            plan.callconv = f->callconv;
+            std::vector<Arg> args;
+            Arg ret;
+            if (!f->rettype.empty() && f->rettype != "void" && !classify(t, f->rettype, ret))
+                return false;
+            for (const auto & a : f->args)
+            {
+                Arg arg;
+                if (!classify(t, a.type, arg))
+                    return false;
+                args.push_back(arg);
+            }
+            switch (f->callconv)
+            {
+            case Cdecl:
+            case Stdcall:
+            case Thiscall:
+                return planX86(args, ret, plan);
+            case Delphi:
+                return planDelphi(args, ret, plan);
+            case Win64:
+                return planWin64(args, ret, plan);
+            case SysV64:
+                return planSysV64(t, f->rettype, f->args, args, ret, plan);
+            }
+            return false;
+        }
+
+        //Decodes all arguments in one pass. values gets plan.locations.size() entries: integers zero extended,
+        //floating point values as their raw bits and references as addresses. stack holds stackSize bytes read from
+        //the first stack argument (entry stack pointer + plan.returnSize), so plan.stackSize bytes cover all of
+        //them; returns false if a stack argument lies outside of it (its value is set to 0).
+        static bool Decode(const ArgumentPlan & plan, const Registers & regs, const void* stack, size_t stackSize, unsigned long long* values)
+        {
+            auto result = true;
+            auto src = (const unsigned char*)stack;
+            auto count = plan.locations.size();
+            for (size_t i = 0; i < count; i++)
+            {
+                const auto & l = plan.locations[i];
+                unsigned long long value = 0;
+                switch (l.kind)
+                {
+                case ArgLocation::Register:
+                    value = regs.gpr[l.reg];
+                    break;
+                case ArgLocation::FloatRegister:
+                    value = regs.xmm[l.reg];
+                    break;
+                case ArgLocation::Stack:
+                    if (l.reference && l.size > 8)
+                        value = regs.gpr[Registers::Rsp] + (unsigned long long)(plan.returnSize + l.offset);
+                    else if (size_t(l.offset) + size_t(l.size) <= stackSize)
+                        memcpy(&value, src + l.offset, size_t(l.size));
+                    else
+                        result = false;
+                    break;
+                }
+                if (l.size < 8)
+                    value &= (1ULL << (l.size * 8)) - 1;
+                values[i] = value;
+            }
+            return result;
+        }
+
+    private:
+        struct Arg
+        {
+            int size = 0;
+            bool isfloat = false;
+            bool isstruct = false;
+        };
+
+        static bool classify(TypeManager & t, const std::string & type, Arg & arg)
+        {
+            arg.size = t.Sizeof(type);
+            if (!arg.size)
+                return false;
+            auto found = t.FindType(type);
+            arg.isfloat = found && (found->primitive == Float || found->primitive == Double);
+            arg.isstruct = !found;
+            return true;
+        }
+
+        static ArgLocation location(int arg, ArgLocation::Kind kind, int reg, int offset, int size, bool reference = false)
+        {
+            ArgLocation l;
+            l.arg = arg;
+            l.kind = kind;
+            l.reg = reg;
+            l.offset = offset;
+            l.size = size;
+            l.reference = reference;
+            return l;
+        }
+
+        //Pushes an argument of size bytes in slot sized stack slots, large arguments are returned by address
+        static void push(ArgumentPlan & plan, int arg, int size, int slot, int & offset)
+        {
+            plan.locations.push_back(location(arg, ArgLocation::Stack, 0, offset, size, size > 8));
+            offset += (size + slot - 1) / slot * slot;
+        }
+
+        static bool planX86(const std::vector<Arg> & args, const Arg & ret, ArgumentPlan & plan)
+        {
+            auto offset = 0;
+            size_t first = 0;
+            if (plan.callconv == Thiscall && !args.empty())
+            {
+                if (args[0].isfloat || args[0].size > 4)
+                    return false; //this pointer
+                plan.locations.push_back(location(0, ArgLocation::Register, Registers::Rcx, 0, args[0].size));
+                first = 1;
+            }
+            if (ret.isstruct && ret.size > 8)
+                push(plan, -1, 4, 4, offset);
+            for (auto i = first; i < args.size(); i++)
+                push(plan, int(i), args[i].size, 4, offset);
+            plan.stackSize = offset;
+            plan.returnSize = 4;
+            plan.calleeCleanup = plan.callconv != Cdecl;
+            return true;
+        }
+
+        //Borland register convention: the first three ordinal arguments in eax, edx, ecx, the rest pushed left to right.
+        //Records that are not 1, 2 or 4 bytes are passed as a pointer, in a register or on the stack.
+        static bool planDelphi(const std::vector<Arg> & args, const Arg & ret, ArgumentPlan & plan)
+        {
+            static const int regs[] = { Registers::Rax, Registers::Rdx, Registers::Rcx };
+            auto used = 0;
+            std::vector<int> stacked;
+            auto assign = [&](int arg, const Arg & a)
+            {
+                auto reference = a.isstruct && a.size != 1 && a.size != 2 && a.size != 4;
+                auto size = reference ? 4 : a.size;
+                if (used < 3 && !a.isfloat && size <= 4)
+                    plan.locations.push_back(location(arg, ArgLocation::Register, regs[used++], 0, size, reference));
+                else
+                {
+                    stacked.push_back(int(plan.locations.size()));
+                    plan.locations.push_back(location(arg, ArgLocation::Stack, 0, 0, size, reference || a.size > 8));
+                }
+            };
+            for (size_t i = 0; i < args.size(); i++)
+                assign(int(i), args[i]);
+            if (ret.isstruct)
+            {
+                Arg result;
+                result.size = 4;
+                assign(-1, result);
+            }
+            auto offset = 0;
+            for (auto i = stacked.size(); i-- > 0; )
+            {
+                auto & l = plan.locations[size_t(stacked[i])];
+                l.offset = offset;
+                offset += (l.size + 3) / 4 * 4;
+            }
+            plan.stackSize = offset;
+            plan.returnSize = 4;
+            plan.calleeCleanup = true;
+            return true;
+        }
+
+        //Four slots (rcx, rdx, r8, r9 or xmm0-3) backed by shadow space, arguments not 1, 2, 4 or 8 bytes go by reference
+        static bool planWin64(const std::vector<Arg> & args, const Arg & ret, ArgumentPlan & plan)
+        {
+            static const int regs[] = { Registers::Rcx, Registers::Rdx, Registers::R8, Registers::R9 };
+            auto slot = 0;
+            if (ret.isstruct && !byValue(ret.size))
+                plan.locations.push_back(location(-1, ArgLocation::Register, regs[slot++], 0, 8));
+            for (size_t i = 0; i < args.size(); i++, slot++)
+            {
+                const auto & a = args[i];
+                auto reference = !byValue(a.size);
+                auto size = reference ? 8 : a.size;
+                if (slot >= 4)
+                    plan.locations.push_back(location(int(i), ArgLocation::Stack, 0, slot * 8, size));
+                else if (a.isfloat)
+                    plan.locations.push_back(location(int(i), ArgLocation::FloatRegister, slot, 0, size));
+                else
+                    plan.locations.push_back(location(int(i), ArgLocation::Register, regs[slot], 0, size));
+                if (reference)
+                {
+                    //the slot holds the address
+                    plan.locations.back().size = 8;
+                    plan.locations.back().reference = true;
+                }
+            }
+            plan.stackSize = (slot > 4 ? slot : 4) * 8;
+            plan.returnSize = 8;
+            return true;
+        }
+
+        static bool byValue(int size)
+        {
+            return size == 1 || size == 2 || size == 4 || size == 8;
+        }
+
+        //Integer arguments in rdi, rsi, rdx, rcx, r8, r9, floating point in xmm0-7, aggregates up to 16 bytes split
+        //into eightbytes classified from their fields, everything else on the stack. Aggregates returned in memory
+        //(larger than 16 bytes or unaligned fields) take a hidden buffer pointer in rdi.
+        static bool planSysV64(TypeManager & t, const std::string & rettype, const std::vector<Member> & members, const std::vector<Arg> & args, const Arg & ret, ArgumentPlan & plan)
+        {
+            static const int regs[] = { Registers::Rdi, Registers::Rsi, Registers::Rdx, Registers::Rcx, Registers::R8, Registers::R9 };
+            auto gpr = 0, sse = 0, offset = 0;
+            bool retFloats[2] = { false, false };
+            if (ret.isstruct && (ret.size > 16 || !eightbytes(t, rettype, retFloats)))
+                plan.locations.push_back(location(-1, ArgLocation::Register, regs[gpr++], 0, 8));
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                const auto & a = args[i];
+                bool floats[2] = { a.isfloat, false };
+                auto parts = a.size > 8 ? 2 : 1;
+                auto memory = a.size > 16 || (a.isstruct && !eightbytes(t, members[i].type, floats));
+                auto needGpr = 0, needSse = 0;
+                for (auto p = 0; p < parts; p++)
+                    (floats[p] ? needSse : needGpr)++;
+                if (memory || gpr + needGpr > 6 || sse + needSse > 8)
+                {
+                    push(plan, int(i), a.size, 8, offset);
+                    continue;
+                }
+                for (auto p = 0; p < parts; p++)
+                {
+                    auto size = p ? a.size - 8 : a.size < 8 ? a.size : 8;
+                    if (floats[p])
+                        plan.locations.push_back(location(int(i), ArgLocation::FloatRegister, sse++, 0, size));
+                    else
+                        plan.locations.push_back(location(int(i), ArgLocation::Register, regs[gpr++], 0, size));
+                    plan.locations.back().part = p * 8;
+                }
+            }
+            plan.stackSize = offset;
+            plan.returnSize = 8;
+            return true;
+        }
+
+        //SSE class per eightbyte of an aggregate, false if it has to be passed in memory (unaligned fields)
+        static bool eightbytes(TypeManager & t, const std::string & type, bool floats[2])
+        {
+            auto layout = t.GetLayout(type);
+            if (!layout || layout->fields.empty())
+                return false;
+            floats[0] = floats[1] = true;
+            for (const auto & f : layout->fields)
+            {
+                if (!f.size || (!f.bitsize && f.offset % f.size) || f.offset / 8 != (f.offset + f.size - 1) / 8)
+                    return false;
+                if (f.bitsize || (f.primitive != Float && f.primitive != Double))
+                    floats[f.offset / 8] = false;
+            }
+            return true;
+        }
+    };
+};
\ No newline at end of file
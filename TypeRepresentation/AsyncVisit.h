@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ProcessMemory.h"
+#include <functional>
+
+namespace Types
+{
+    //Interleaves visits on one thread over a PageCache. A visit that needs memory that is not read yet
+    //is parked while the others run and is resumed once the read completes, so the reads of all visits overlap.
+    struct VisitScheduler
+    {
+        typedef std::function<void(bool)> Callback;
+
+        VisitScheduler(TypeManager & types, PageCache & cache)
+            : mTypes(types), mCache(cache) { }
+
+        //Starts a visit, done gets the result once it completes. The visitor has to read through the cache
+        //(DataVisitor::SetReader) and has to outlive the visit.
+        void Add(const std::string & name, const std::string & type, TypeManager::Visitor & visitor, const Callback & done = Callback())
+        {
+            Task task;
+            task.visitor = &visitor;
+            task.done = done;
+            mTasks.push_back(task);
+            auto & added = mTasks.back();
+            if (mTypes.AsyncVisit(added.state, name, type, visitor) != TypeManager::VisitState::Waiting)
+                finish(mTasks.size() - 1);
+        }
+
+        //Resumes every waiting visit once, then (with wait) blocks until more reads completed. Returns the unfinished visits.
+        //With a budget each visit runs at most that much and no visit is resumed after its deadline (for example once per UI frame).
+        size_t Run(bool wait = true, const VisitBudget* budget = nullptr)
+        {
+            mCache.Pump(false);
+            for (size_t i = 0; i < mTasks.size();)
+            {
+                if (budget && VisitBudget::Clock::now() >= budget->deadline)
+                    return mTasks.size();
+                auto status = mTypes.Resume(mTasks[i].state, *mTasks[i].visitor, budget);
+                if (status == TypeManager::VisitState::Waiting || status == TypeManager::VisitState::Suspended)
+                    i++;
+                else
+                    finish(i);
+            }
+            if (wait && !mTasks.empty())
+                mCache.Pump(true);
+            return mTasks.size();
+        }
+
+        //Runs until all visits completed
+        void Wait()
+        {
+            while (Run(true))
+                ;
+        }
+
+        size_t Pending() const
+        {
+            return mTasks.size();
+        }
+
+    private:
+        struct Task
+        {
+            TypeManager::VisitState state;
+            TypeManager::Visitor* visitor = nullptr;
+            Callback done;
+        };
+
+        TypeManager & mTypes;
+        PageCache & mCache;
+        std::vector<Task> mTasks;
+
+        void finish(size_t index)
+        {
+            auto done = mTasks[index].done;
+            auto success = mTasks[index].state.status == TypeManager::VisitState::Done;
+            mTasks.erase(mTasks.begin() + index);
+            if (done)
+                done(success); //may add visits
+        }
+    };
+};
\ No newline at end of file
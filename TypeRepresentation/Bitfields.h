@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Types.h"
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TYPES_AVX2
+#endif
+
+namespace Types
+{
+    //Decodes all bitfields of a type in one pass. Every storage unit is loaded once, then each field is
+    //extracted branch-free as ((unit << left) >> right) with a xor/subtract sign extension (four at a time with AVX2).
+    struct BitfieldDecoder
+    {
+        //Bits of a bitfield from the value of its storage unit, sign extended to 64 bits if isSigned
+        static unsigned long long Extract(unsigned long long unit, int bitoffset, int bitsize, bool isSigned)
+        {
+            auto value = (unit << (64 - bitoffset - bitsize)) >> (64 - bitsize);
+            auto sign = isSigned ? 1ULL << (bitsize - 1) : 0;
+            return (value ^ sign) - sign;
+        }
+
+        bool Compile(TypeManager & t, const std::string & type)
+        {
+            mFields.clear();
+            mUnitOffset.clear();
+            mUnitSize.clear();
+            mUnitIndex.clear();
+            mLeft.clear();
+            mRight.clear();
+            mSign.clear();
+            auto layout = t.GetLayout(type);
+            if (!layout)
+                return false;
+            for (const auto & f : layout->fields)
+            {
+                if (!f.bitsize)
+                    continue;
+                if (mUnitOffset.empty() || mUnitOffset.back() != f.offset || mUnitSize.back() != f.size)
+                {
+                    mUnitOffset.push_back(f.offset);
+                    mUnitSize.push_back(f.size);
+                }
+                mFields.push_back(f);
+                mUnitIndex.push_back(int(mUnitOffset.size() - 1));
+                mLeft.push_back((unsigned long long)(64 - f.bitoffset - f.bitsize));
+                mRight.push_back((unsigned long long)(64 - f.bitsize));
+                mSign.push_back(isSigned(f.primitive) ? 1ULL << (f.bitsize - 1) : 0);
+            }
+            mUnits.resize(mUnitOffset.size());
+            return true;
+        }
+
+        //Bitfields in decode order
+        const std::vector<Field> & Fields() const
+        {
+            return mFields;
+        }
+
+        size_t Count() const
+        {
+            return mFields.size();
+        }
+
+        //Decodes the bitfields of the instance at data into values (Count() entries)
+        void Decode(const void* data, unsigned long long* values)
+        {
+            auto src = (const unsigned char*)data;
+            for (size_t u = 0; u < mUnits.size(); u++)
+            {
+                unsigned long long unit = 0;
+                memcpy(&unit, src + mUnitOffset[u], size_t(mUnitSize[u]));
+                mUnits[u] = unit;
+            }
+            size_t i = 0;
+            auto count = mFields.size();
+#ifdef TYPES_AVX2
+            for (; i + 4 <= count; i += 4)
+            {
+                auto index = _mm_loadu_si128((const __m128i*)(mUnitIndex.data() + i));
+                auto unit = _mm256_i32gather_epi64((const long long*)mUnits.data(), index, 8);
+                auto left = _mm256_loadu_si256((const __m256i*)(mLeft.data() + i));
+                auto right = _mm256_loadu_si256((const __m256i*)(mRight.data() + i));
+                auto sign = _mm256_loadu_si256((const __m256i*)(mSign.data() + i));
+                auto value = _mm256_srlv_epi64(_mm256_sllv_epi64(unit, left), right);
+                value = _mm256_sub_epi64(_mm256_xor_si256(value, sign), sign);
+                _mm256_storeu_si256((__m256i*)(values + i), value);
+            }
+#endif
+            for (; i < count; i++)
+                values[i] = (((mUnits[mUnitIndex[i]] << mLeft[i]) >> mRight[i]) ^ mSign[i]) - mSign[i];
+        }
+
+        //Decodes count instances stride bytes apart, values gets Count() entries per instance
+        void Decode(const void* data, size_t count, size_t stride, unsigned long long* values)
+        {
+            auto src = (const unsigned char*)data;
+            for (size_t row = 0; row < count; row++, src += stride, values += mFields.size())
+                Decode(src, values);
+        }
+
+    private:
+        std::vector<Field> mFields;
+        std::vector<int> mUnitOffset;
+        std::vector<int> mUnitSize;
+        std::vector<unsigned long long> mUnits; //Storage units of the instance being decoded
+        std::vector<int> mUnitIndex; //Per field (structure of arrays for the vector loop)
+        std::vector<unsigned long long> mLeft;
+        std::vector<unsigned long long> mRight;
+        std::vector<unsigned long long> mSign;
+
+        static bool isSigned(Primitive primitive)
+        {
+            return primitive == Int8 || primitive == Int16 || primitive == Int32 || primitive == Int64 || primitive == Dsint;
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,458 @@
+#pragma once
+
+#include "Types.h"
+#include "Memory.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace Types
+{
+    struct CensusRoot
+    {
+        duint address = 0; //Address of the root object
+        std::string type; //StructUnion of the root object
+    };
+
+    struct CensusEntry
+    {
+        std::string type; //StructUnion identifier
+        size_t count = 0; //Reachable instances
+        unsigned long long bytes = 0; //Shallow size of the instances
+        unsigned long long retained = 0; //Bytes only reachable through the instances (instances nested in another one count once)
+    };
+
+    //Walks the object graph reachable from typed roots through the typed pointer fields of the structs (resolving
+    //polymorphic pointees through their vptr) and reports counts, bytes and retained sizes (from the dominator
+    //tree) per type. The graph is discovered breadth first by one thread per reader, the dominators are computed
+    //afterwards with the iterative algorithm of Cooper, Harvey and Kennedy.
+    struct HeapCensus
+    {
+        //The readers are not shared between threads (e.g. one ElfCoreReader per thread over the same core file).
+        //Objects are identified by their address, the first type that reaches one wins. maxObjects (0 = no limit)
+        //stops the walk early (see Truncated).
+        bool Run(TypeManager & t, const std::vector<CensusRoot> & roots, const std::vector<MemoryReader*> & readers, std::vector<CensusEntry> & result, size_t maxObjects = 0)
+        {
+            result.clear();
+            mShapes.clear();
+            mShapeIndex.clear();
+            mVtables.clear();
+            mAddress.clear();
+            mType.clear();
+            mValid.clear();
+            for (auto & s : mShards)
+                s.ids.clear();
+            mTruncated = false;
+            if (readers.empty())
+                return false;
+            mPointerSize = t.Sizeof("ptr");
+            std::vector<int> frontier;
+            for (const auto & r : roots)
+            {
+                auto type = shape(t, r.type);
+                if (type < 0)
+                    return false;
+                if (r.address && insert(r.address, -1))
+                {
+                    shard(r.address).ids[r.address] = int(mAddress.size());
+                    frontier.push_back(int(mAddress.size()));
+                    mAddress.push_back(r.address);
+                    mType.push_back(type);
+                }
+            }
+            prepareVtables(t);
+            mValid.assign(mAddress.size(), 0);
+
+            std::vector<Worker> workers(readers.size());
+            while (!frontier.empty())
+            {
+                walk(frontier, readers, workers);
+                frontier.clear();
+                for (auto & w : workers)
+                {
+                    for (const auto & d : w.discovered)
+                    {
+                        if (maxObjects && mAddress.size() >= maxObjects)
+                        {
+                            mTruncated = true;
+                            break;
+                        }
+                        shard(d.address).ids[d.address] = int(mAddress.size());
+                        frontier.push_back(int(mAddress.size()));
+                        mAddress.push_back(d.address);
+                        mType.push_back(d.type);
+                    }
+                    w.discovered.clear();
+                }
+                mValid.resize(mAddress.size(), 0);
+            }
+
+            std::vector<int> idom;
+            std::vector<int> order;
+            dominators(workers, roots, idom, order);
+            report(idom, order, result);
+            return true;
+        }
+
+        //Number of objects found by the last Run
+        size_t Objects() const
+        {
+            return mAddress.size();
+        }
+
+        //The last Run stopped at maxObjects
+        bool Truncated() const
+        {
+            return mTruncated;
+        }
+
+    private:
+        struct Edge
+        {
+            int offset = 0; //Offset of the pointer field
+            int type = -1; //Shape of the pointee
+        };
+
+        struct Shape
+        {
+            std::string type;
+            int size = 0;
+            bool polymorphic = false;
+            std::vector<Edge> edges;
+        };
+
+        struct Found
+        {
+            duint address = 0;
+            int type = -1;
+        };
+
+        //Per thread output of a breadth first step
+        struct Worker
+        {
+            std::vector<Found> discovered;
+            std::vector<std::pair<int, duint>> edges; //object -> address of the target
+        };
+
+        //Part of the visited set (sharded by address so the threads rarely contend)
+        struct Shard
+        {
+            std::mutex lock;
+            std::unordered_map<duint, int> ids; //-1 until the object is numbered
+        };
+
+        static const size_t ShardCount = 64;
+
+        std::vector<Shape> mShapes;
+        std::unordered_map<std::string, int> mShapeIndex;
+        std::unordered_map<unsigned long long, std::pair<int, int>> mVtables; //vptr -> shape, subobject offset
+        std::vector<duint> mAddress; //Object id -> address
+        std::vector<int> mType; //Object id -> shape
+        std::vector<char> mValid; //Object id -> its memory could be read
+        Shard mShards[ShardCount];
+        int mPointerSize = int(sizeof(void*));
+        bool mTruncated = false;
+
+        Shard & shard(duint address)
+        {
+            return mShards[size_t((address * 0x9E3779B97F4A7C15ULL) >> 58)];
+        }
+
+        bool insert(duint address, int id)
+        {
+            auto & s = shard(address);
+            std::lock_guard<std::mutex> guard(s.lock);
+            return s.ids.insert({ address, id }).second;
+        }
+
+        //Shape of a struct and (recursively) of the structs its pointer fields point to, -1 if it is not a struct
+        int shape(TypeManager & t, const std::string & type)
+        {
+            auto found = mShapeIndex.find(type);
+            if (found != mShapeIndex.end())
+                return found->second;
+            auto s = t.FindStruct(type);
+            auto layout = s ? t.GetLayout(type) : nullptr;
+            if (!layout)
+                return -1;
+            auto index = int(mShapes.size());
+            mShapeIndex[type] = index;
+            mShapes.push_back(Shape());
+            mShapes[index].type = type;
+            mShapes[index].size = layout->size;
+            mShapes[index].polymorphic = s->polymorphic;
+            std::vector<Edge> edges;
+            for (const auto & f : layout->fields)
+            {
+                auto pointer = f.primitive == Pointer && !f.bitsize ? t.FindType(f.type) : nullptr;
+                if (!pointer || pointer->pointto.empty())
+                    continue;
+                Edge e;
+                e.offset = f.offset;
+                e.type = shape(t, pointer->pointto);
+                if (e.type >= 0)
+                    edges.push_back(e);
+            }
+            mShapes[index].edges.swap(edges);
+            return index;
+        }
+
+        void prepareVtables(TypeManager & t)
+        {
+            auto polymorphic = false;
+            for (const auto & s : mShapes)
+                polymorphic |= s.polymorphic;
+            if (!polymorphic)
+                return;
+            for (const auto & v : t.Vtables())
+            {
+                auto type = shape(t, v.second.type);
+                if (type >= 0)
+                    mVtables[v.first] = std::make_pair(type, v.second.offset);
+            }
+        }
+
+        //Reads the objects of the frontier and collects the ones they point to that were not seen before
+        void walk(const std::vector<int> & frontier, const std::vector<MemoryReader*> & readers, std::vector<Worker> & workers)
+        {
+            std::atomic<size_t> next(0);
+            auto work = [&](size_t index)
+            {
+                auto & reader = *readers[index];
+                auto & w = workers[index];
+                std::vector<unsigned char> data;
+                const size_t block = 256;
+                for (auto first = next.fetch_add(block); first < frontier.size(); first = next.fetch_add(block))
+                {
+                    auto last = std::min(first + block, frontier.size());
+                    for (auto i = first; i < last; i++)
+                        object(frontier[i], reader, w, data);
+                }
+            };
+            auto threads = std::min(readers.size(), (frontier.size() + 255) / 256);
+            if (threads <= 1)
+                work(0);
+            else
+            {
+                std::vector<std::thread> pool;
+                for (size_t i = 0; i < threads; i++)
+                    pool.push_back(std::thread(work, i));
+                for (auto & p : pool)
+                    p.join();
+            }
+        }
+
+        void object(int id, MemoryReader & reader, Worker & w, std::vector<unsigned char> & data)
+        {
+            const auto & s = mShapes[size_t(mType[size_t(id)])];
+            data.resize(size_t(s.size));
+            if (!s.size || !reader.Read(mAddress[size_t(id)], data.data(), data.size()))
+                return;
+            mValid[size_t(id)] = 1;
+            for (const auto & e : s.edges)
+            {
+                unsigned long long target = 0;
+                memcpy(&target, data.data() + e.offset, size_t(mPointerSize));
+                if (!target)
+                    continue;
+                auto type = e.type;
+                if (mShapes[size_t(type)].polymorphic && !mVtables.empty())
+                {
+                    unsigned long long vptr = 0;
+                    if (reader.Read(duint(target), &vptr, size_t(mPointerSize)))
+                    {
+                        auto found = mVtables.find(vptr);
+                        if (found != mVtables.end())
+                        {
+                            type = found->second.first;
+                            target -= (unsigned long long)found->second.second;
+                        }
+                    }
+                }
+                w.edges.push_back(std::make_pair(id, duint(target)));
+                if (insert(duint(target), -1))
+                {
+                    Found f;
+                    f.address = duint(target);
+                    f.type = type;
+                    w.discovered.push_back(f);
+                }
+            }
+        }
+
+        //Immediate dominators (node 0 is a virtual root pointing to the roots, object i is node i + 1) and the
+        //reverse postorder of the nodes
+        void dominators(std::vector<Worker> & workers, const std::vector<CensusRoot> & roots, std::vector<int> & idom, std::vector<int> & order)
+        {
+            auto n = mAddress.size() + 1;
+            std::vector<std::pair<int, int>> edges;
+            for (const auto & r : roots)
+            {
+                auto & ids = shard(r.address).ids;
+                auto found = ids.find(r.address);
+                if (r.address && found != ids.end())
+                    edges.push_back(std::make_pair(0, found->second + 1));
+            }
+            for (auto & w : workers)
+            {
+                for (const auto & e : w.edges)
+                {
+                    auto & ids = shard(e.second).ids;
+                    auto found = ids.find(e.second);
+                    if (found != ids.end() && found->second >= 0) //not numbered if the walk was truncated
+                        edges.push_back(std::make_pair(e.first + 1, found->second + 1));
+                }
+                std::vector<std::pair<int, duint>>().swap(w.edges);
+            }
+
+            std::vector<size_t> succStart, predStart;
+            std::vector<int> succ, pred;
+            csr(n, edges, false, succStart, succ);
+            csr(n, edges, true, predStart, pred);
+            std::vector<std::pair<int, int>>().swap(edges);
+
+            //reverse postorder by an iterative depth first search
+            std::vector<int> number(n, -1); //reverse postorder number
+            std::vector<char> seen(n, 0);
+            std::vector<std::pair<int, size_t>> stack;
+            order.clear();
+            stack.push_back(std::make_pair(0, succStart[0]));
+            seen[0] = 1;
+            while (!stack.empty())
+            {
+                auto & top = stack.back();
+                if (top.second < succStart[size_t(top.first) + 1])
+                {
+                    auto next = succ[top.second++];
+                    if (!seen[size_t(next)])
+                    {
+                        seen[size_t(next)] = 1;
+                        stack.push_back(std::make_pair(next, succStart[size_t(next)]));
+                    }
+                    continue;
+                }
+                order.push_back(top.first);
+                stack.pop_back();
+            }
+            std::reverse(order.begin(), order.end());
+            for (size_t i = 0; i < order.size(); i++)
+                number[size_t(order[i])] = int(i);
+
+            idom.assign(n, -1);
+            idom[0] = 0;
+            for (auto changed = true; changed; )
+            {
+                changed = false;
+                for (size_t i = 1; i < order.size(); i++)
+                {
+                    auto node = size_t(order[i]);
+                    auto dom = -1;
+                    for (auto p = predStart[node]; p < predStart[node + 1]; p++)
+                    {
+                        auto pre = pred[p];
+                        if (idom[size_t(pre)] < 0)
+                            continue;
+                        dom = dom < 0 ? pre : intersect(pre, dom, idom, number);
+                    }
+                    if (idom[node] != dom)
+                    {
+                        idom[node] = dom;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        static int intersect(int a, int b, const std::vector<int> & idom, const std::vector<int> & number)
+        {
+            while (a != b)
+            {
+                while (number[size_t(a)] > number[size_t(b)])
+                    a = idom[size_t(a)];
+                while (number[size_t(b)] > number[size_t(a)])
+                    b = idom[size_t(b)];
+            }
+            return a;
+        }
+
+        //Compressed adjacency lists (targets of the edges leaving each node, or sources if reverse)
+        static void csr(size_t n, const std::vector<std::pair<int, int>> & edges, bool reverse, std::vector<size_t> & start, std::vector<int> & targets)
+        {
+            start.assign(n + 1, 0);
+            for (const auto & e : edges)
+                start[size_t(reverse ? e.second : e.first) + 1]++;
+            for (size_t i = 0; i < n; i++)
+                start[i + 1] += start[i];
+            targets.resize(edges.size());
+            std::vector<size_t> fill(start.begin(), start.end() - 1);
+            for (const auto & e : edges)
+                targets[fill[size_t(reverse ? e.second : e.first)]++] = reverse ? e.first : e.second;
+        }
+
+        void report(const std::vector<int> & idom, const std::vector<int> & order, std::vector<CensusEntry> & result)
+        {
+            auto n = idom.size();
+            std::vector<unsigned long long> retained(n, 0);
+            result.resize(mShapes.size());
+            for (size_t i = 0; i < mShapes.size(); i++)
+                result[i].type = mShapes[i].type;
+            for (size_t id = 0; id < mAddress.size(); id++)
+            {
+                if (!mValid[id])
+                    continue;
+                auto & entry = result[size_t(mType[id])];
+                auto size = (unsigned long long)mShapes[size_t(mType[id])].size;
+                entry.count++;
+                entry.bytes += size;
+                retained[id + 1] = size;
+            }
+            for (auto i = order.size(); i-- > 1; )
+            {
+                auto node = size_t(order[i]);
+                retained[size_t(idom[node])] += retained[node];
+            }
+
+            //instances below another instance of the same type in the dominator tree are part of its retained size
+            std::vector<std::pair<int, int>> tree;
+            for (size_t node = 1; node < n; node++)
+                if (idom[node] >= 0)
+                    tree.push_back(std::make_pair(idom[node], int(node)));
+            std::vector<size_t> start;
+            std::vector<int> children;
+            csr(n, tree, false, start, children);
+            std::vector<int> active(mShapes.size(), 0);
+            std::vector<std::pair<int, bool>> stack; //node, leaving
+            stack.push_back(std::make_pair(0, false));
+            while (!stack.empty())
+            {
+                auto node = stack.back().first;
+                auto leaving = stack.back().second;
+                stack.pop_back();
+                auto type = node ? mType[size_t(node) - 1] : -1;
+                if (leaving)
+                {
+                    active[size_t(type)]--;
+                    continue;
+                }
+                if (type >= 0)
+                {
+                    if (!active[size_t(type)]++)
+                        result[size_t(type)].retained += retained[size_t(node)];
+                    stack.push_back(std::make_pair(node, true));
+                }
+                for (auto c = start[size_t(node)]; c < start[size_t(node) + 1]; c++)
+                    stack.push_back(std::make_pair(children[c], false));
+            }
+
+            result.erase(std::remove_if(result.begin(), result.end(), [](const CensusEntry & e)
+            {
+                return !e.count;
+            }), result.end());
+            std::sort(result.begin(), result.end(), [](const CensusEntry & a, const CensusEntry & b)
+            {
+                return a.retained > b.retained || (a.retained == b.retained && a.type < b.type);
+            });
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Types.h"
+#include "Bitfields.h"
+#include <cstring>
+
+namespace Types
+{
+    struct Column
+    {
+        std::string path; //Field.path
+        std::string type; //Field.type
+        Primitive primitive; //Field.primitive
+        int size = 0; //Size of one element in bytes
+        int bitsize = 0; //Width of a bitfield (elements hold the extracted, sign extended value)
+        std::vector<unsigned char> data; //count elements of size bytes
+
+        template<typename T>
+        const T* As() const
+        {
+            return sizeof(T) == size_t(size) ? (const T*)data.data() : nullptr;
+        }
+    };
+
+    //Struct-of-arrays export: one contiguous column per leaf field of count consecutive instances.
+    struct ColumnExporter
+    {
+        //stride defaults to the size of the type (a plain array of instances)
+        static bool Export(TypeManager & t, const std::string & type, const void* base, size_t count, std::vector<Column> & columns, size_t stride = 0)
+        {
+            columns.clear();
+            auto layout = t.GetLayout(type);
+            if (!layout || !base || !layout->size)
+                return false;
+            if (!stride)
+                stride = size_t(layout->size);
+
+            columns.resize(layout->fields.size());
+            for (size_t i = 0; i < columns.size(); i++)
+            {
+                const auto & f = layout->fields[i];
+                auto & c = columns[i];
+                c.path = f.path;
+                c.type = f.type;
+                c.primitive = f.primitive;
+                c.size = f.size;
+                c.bitsize = f.bitsize;
+                c.data.resize(count * size_t(f.size));
+            }
+
+            //gather the columns one block of rows at a time so the source rows stay in cache
+            auto src = (const unsigned char*)base;
+            const size_t rowsPerBlock = stride >= 4096 ? 16 : 65536 / stride + 1;
+            for (size_t row = 0; row < count; row += rowsPerBlock)
+            {
+                auto rows = count - row < rowsPerBlock ? count - row : rowsPerBlock;
+                auto block = src + row * stride;
+                for (size_t i = 0; i < columns.size(); i++)
+                {
+                    const auto & f = layout->fields[i];
+                    auto dst = columns[i].data.data() + row * size_t(f.size);
+                    gather(dst, block + f.offset, f.size, stride, rows);
+                    if (f.bitsize)
+                        extract(dst, f, rows);
+                }
+            }
+            return true;
+        }
+
+    private:
+        //Replaces the gathered storage units by the bitfield values
+        template<typename T>
+        static void extract(T* units, const Field & f, size_t rows)
+        {
+            auto isSigned = f.primitive == Int8 || f.primitive == Int16 || f.primitive == Int32 || f.primitive == Int64 || f.primitive == Dsint;
+            for (size_t i = 0; i < rows; i++)
+                units[i] = T(BitfieldDecoder::Extract(units[i], f.bitoffset, f.bitsize, isSigned));
+        }
+
+        static void extract(unsigned char* dst, const Field & f, size_t rows)
+        {
+            switch (f.size)
+            {
+            case 1:
+                extract((unsigned char*)dst, f, rows);
+                break;
+            case 2:
+                extract((unsigned short*)dst, f, rows);
+                break;
+            case 4:
+                extract((unsigned int*)dst, f, rows);
+                break;
+            case 8:
+                extract((unsigned long long*)dst, f, rows);
+                break;
+            }
+        }
+
+        template<typename T>
+        static void gather(T* dst, const unsigned char* src, size_t stride, size_t rows)
+        {
+            size_t i = 0;
+            for (; i + 4 <= rows; i += 4, src += stride * 4)
+            {
+                memcpy(dst + i, src, sizeof(T));
+                memcpy(dst + i + 1, src + stride, sizeof(T));
+                memcpy(dst + i + 2, src + stride * 2, sizeof(T));
+                memcpy(dst + i + 3, src + stride * 3, sizeof(T));
+            }
+            for (; i < rows; i++, src += stride)
+                memcpy(dst + i, src, sizeof(T));
+        }
+
+        static void gather(unsigned char* dst, const unsigned char* src, int size, size_t stride, size_t rows)
+        {
+            switch (size)
+            {
+            case 1:
+                gather((unsigned char*)dst, src, stride, rows);
+                break;
+            case 2:
+                gather((unsigned short*)dst, src, stride, rows);
+                break;
+            case 4:
+                gather((unsigned int*)dst, src, stride, rows);
+                break;
+            case 8:
+                gather((unsigned long long*)dst, src, stride, rows);
+                break;
+            default:
+                for (size_t i = 0; i < rows; i++)
+                    memcpy(dst + i * size, src + i * stride, size_t(size));
+                break;
+            }
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "Types.h"
+
+namespace Types
+{
+    //Pull-style walk over the leaf members of a type in visit order. Nothing is flattened up front, the
+    //cursor only keeps the chain of structs it is in, so two cursors can be advanced side by side (diff, merge).
+    //Pointers are leaves (their pointees are not entered). The type system must not change while a cursor is used.
+    struct LayoutCursor
+    {
+        LayoutCursor(TypeManager & t, const std::string & type)
+            : mTypes(t), mType(type)
+        {
+            Reset();
+        }
+
+        //Positions the cursor before the first leaf
+        void Reset()
+        {
+            mStack.clear();
+            mPath.clear();
+            mLeaf = nullptr;
+            mOffset = 0;
+            mDepth = 0;
+            mRootDone = false;
+        }
+
+        //Moves to the next leaf, false at the end
+        bool Next()
+        {
+            mLeaf = nullptr;
+            if (!mRootDone)
+            {
+                mRootDone = true;
+                if (enter(mType, "", 0, 0))
+                    return true;
+            }
+            while (!mStack.empty())
+            {
+                auto & frame = mStack.back();
+                if (frame.child >= frame.type->members.size())
+                {
+                    mStack.pop_back();
+                    continue;
+                }
+                const auto & member = frame.type->members[frame.child];
+                auto count = member.arrsize ? member.arrsize : 1;
+                if (frame.element >= count)
+                {
+                    frame.child++;
+                    frame.element = 0;
+                    continue;
+                }
+                auto index = frame.element++;
+                auto offset = frame.offset + member.offset + index * mTypes.Sizeof(member.type);
+                pathTo(frame, member, index);
+                if (enter(member.type, mPath, offset, int(mStack.size())))
+                    return true;
+            }
+            return false;
+        }
+
+        //Moves to the leaf that contains offset or, in padding, to the next leaf after it. Whole members
+        //and array elements before offset are skipped without being walked.
+        bool Seek(int offset)
+        {
+            Reset();
+            mRootDone = true;
+            if (!enter(mType, "", 0, 0))
+            {
+                if (mStack.empty())
+                    return false;
+                while (true)
+                {
+                    auto & frame = mStack.back();
+                    const auto & members = frame.type->members;
+                    auto relative = offset - frame.offset;
+                    auto & child = frame.child;
+                    for (child = 0; child < members.size(); child++)
+                    {
+                        const auto & m = members[child];
+                        if (m.offset + mTypes.Sizeof(m.type) * (m.arrsize ? m.arrsize : 1) > relative)
+                            break;
+                    }
+                    if (child >= members.size())
+                        break; //in the trailing padding
+                    const auto & member = members[child];
+                    auto size = mTypes.Sizeof(member.type);
+                    frame.element = member.arrsize && size && relative > member.offset ? (relative - member.offset) / size : 0;
+                    auto nested = mTypes.FindStruct(member.type);
+                    if (!nested || relative < member.offset)
+                        break;
+                    //enter the struct that contains offset, Next() picks its leaf
+                    auto base = frame.offset + member.offset + frame.element * size;
+                    Frame inner;
+                    inner.type = nested;
+                    inner.offset = base;
+                    inner.path = pathTo(frame, member, frame.element);
+                    frame.element++;
+                    mStack.push_back(inner);
+                }
+                return Next();
+            }
+            return offset < mTypes.Sizeof(mType) || Next();
+        }
+
+        bool End() const
+        {
+            return !mLeaf;
+        }
+
+        const std::string & Path() const { return mPath; } //Member path from the root (e.g. e.d[0])
+        int Offset() const { return mOffset; } //Offset of the leaf from the start of the root
+        const Type* Leaf() const { return mLeaf; } //Leaf type, nullptr at the end
+        int Depth() const { return mDepth; } //Number of structs/unions the leaf is nested in
+
+    private:
+        struct Frame
+        {
+            const StructUnion* type = nullptr;
+            size_t child = 0; //current member
+            int element = 0; //next element of the current member
+            int offset = 0; //offset of the struct from the root
+            size_t path = 0; //length of the struct path
+        };
+
+        TypeManager & mTypes;
+        std::string mType;
+        std::vector<Frame> mStack;
+        std::string mPath;
+        const Type* mLeaf = nullptr;
+        int mOffset = 0;
+        int mDepth = 0;
+        bool mRootDone = false;
+
+        //Reports a leaf (true) or pushes a struct/union to walk
+        bool enter(const std::string & type, const std::string & path, int offset, int depth)
+        {
+            auto leaf = mTypes.FindType(type);
+            if (leaf)
+            {
+                mLeaf = leaf;
+                mPath = path;
+                mOffset = offset;
+                mDepth = depth;
+                return true;
+            }
+            auto s = mTypes.FindStruct(type);
+            if (s)
+            {
+                Frame frame;
+                frame.type = s;
+                frame.offset = offset;
+                frame.path = path.size();
+                mPath = path;
+                mStack.push_back(frame);
+            }
+            return false;
+        }
+
+        size_t pathTo(const Frame & frame, const Member & member, int element)
+        {
+            mPath.resize(frame.path);
+            if (frame.path)
+                mPath.push_back('.');
+            mPath += member.name;
+            if (member.arrsize)
+            {
+                char suffix[32] = "";
+                sprintf_s(suffix, "[%d]", element);
+                mPath += suffix;
+            }
+            return mPath.size();
+        }
+    };
+};
\ No newline at end of file
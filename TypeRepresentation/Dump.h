@@ -0,0 +1,433 @@
+#pragma once
+
+#include "Memory.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Types
+{
+    //Read-only memory mapping of a whole file.
+    struct MappedFile
+    {
+        MappedFile() { }
+
+        ~MappedFile()
+        {
+            Close();
+        }
+
+        bool Open(const std::string & path)
+        {
+            Close();
+#ifdef _WIN32
+            mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (mFile == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(mFile, &size) || !size.QuadPart || (unsigned long long)size.QuadPart > size_t(-1))
+                return fail();
+            mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mMapping)
+                return fail();
+            mData = (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+            if (!mData)
+                return fail();
+            mSize = size_t(size.QuadPart);
+#else
+            mFile = open(path.c_str(), O_RDONLY);
+            if (mFile < 0)
+                return false;
+            struct stat st;
+            if (fstat(mFile, &st) != 0 || st.st_size <= 0 || (unsigned long long)st.st_size > size_t(-1))
+                return fail();
+            auto data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, mFile, 0);
+            if (data == MAP_FAILED)
+                return fail();
+            mData = (const unsigned char*)data;
+            mSize = size_t(st.st_size);
+#endif
+            return true;
+        }
+
+        void Close()
+        {
+#ifdef _WIN32
+            if (mData)
+                UnmapViewOfFile(mData);
+            if (mMapping)
+                CloseHandle(mMapping);
+            if (mFile != INVALID_HANDLE_VALUE)
+                CloseHandle(mFile);
+            mMapping = nullptr;
+            mFile = INVALID_HANDLE_VALUE;
+#else
+            if (mData)
+                munmap((void*)mData, mSize);
+            if (mFile >= 0)
+                close(mFile);
+            mFile = -1;
+#endif
+            mData = nullptr;
+            mSize = 0;
+        }
+
+        const unsigned char* Data() const { return mData; }
+        size_t Size() const { return mSize; }
+
+        //Pointer to size bytes at offset, nullptr if they are outside of the file
+        const unsigned char* At(unsigned long long offset, size_t size) const
+        {
+            if (offset > mSize || size > mSize - size_t(offset))
+                return nullptr;
+            return mData + size_t(offset);
+        }
+
+    private:
+        MappedFile(const MappedFile &);
+        MappedFile & operator=(const MappedFile &);
+
+        bool fail()
+        {
+            Close();
+            return false;
+        }
+
+        const unsigned char* mData = nullptr;
+        size_t mSize = 0;
+#ifdef _WIN32
+        HANDLE mFile = INVALID_HANDLE_VALUE;
+        HANDLE mMapping = nullptr;
+#else
+        int mFile = -1;
+#endif
+    };
+
+    //Virtual address ranges of a dump and where their bytes live in the file.
+    struct Segment
+    {
+        duint start = 0; //First virtual address
+        duint size = 0; //Size in memory
+        unsigned long long offset = 0; //File offset of the first byte
+        duint fileSize = 0; //Bytes present in the file, the rest of the segment was not saved and cannot be read
+        int protection = Region::Read; //Region::Protection flags
+    };
+
+    //Memory reader over a mapped dump file. Reads are served straight from the mapping.
+    struct DumpReader : MemoryReader
+    {
+        bool Read(duint address, void* buffer, size_t size) override
+        {
+            auto dest = (unsigned char*)buffer;
+            while (size)
+            {
+                auto s = find(address);
+                if (!s)
+                    return false;
+                auto skip = address - s->start;
+                auto n = s->fileSize - skip < size ? size_t(s->fileSize - skip) : size;
+                memcpy(dest, mFile.Data() + size_t(s->offset + skip), n);
+                dest += n;
+                address += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool IsValid(duint address, size_t size) override
+        {
+            if (address + size < address)
+                return false;
+            while (size)
+            {
+                auto s = find(address);
+                if (!s)
+                    return false;
+                auto n = s->fileSize - (address - s->start);
+                if (n >= size)
+                    return true;
+                address += n;
+                size -= size_t(n);
+            }
+            return true;
+        }
+
+        int WideCharSize() override
+        {
+            return mWideCharSize;
+        }
+
+        //Pointer into the mapping if the range is file backed within a single segment
+        const void* Map(duint address, size_t size) override
+        {
+            auto s = find(address);
+            if (!s)
+                return nullptr;
+            auto skip = address - s->start;
+            if (skip + size < skip || skip + size > s->fileSize)
+                return nullptr;
+            return mFile.Data() + size_t(s->offset + skip);
+        }
+
+        const std::vector<Segment> & Segments() const
+        {
+            return mSegments;
+        }
+
+        //Region map of the dump (e.g. for LocalMemoryReader-style validation in other tools)
+        void GetRegions(RegionMap & regions) const
+        {
+            regions.Clear();
+            for (const auto & s : mSegments)
+                if (s.fileSize)
+                    regions.Add(s.start, s.fileSize, s.protection);
+        }
+
+        void Close()
+        {
+            mSegments.clear();
+            mStarts.clear();
+            mLast = nullptr;
+            mFile.Close();
+        }
+
+    protected:
+        MappedFile mFile;
+        int mWideCharSize = int(sizeof(wchar_t));
+
+        bool fail()
+        {
+            Close();
+            return false;
+        }
+
+        //Little endian value at a file offset (zero if it is outside of the file)
+        template<typename T>
+        T read(unsigned long long offset) const
+        {
+            T value = T();
+            auto data = mFile.At(offset, sizeof(T));
+            if (data)
+                memcpy(&value, data, sizeof(T));
+            return value;
+        }
+
+        //Sorts the segments and drops the ones that overlap or point outside of the file
+        void addSegments(std::vector<Segment> & segments)
+        {
+            std::sort(segments.begin(), segments.end(), [](const Segment & a, const Segment & b)
+            {
+                return a.start < b.start;
+            });
+            mSegments.clear();
+            mStarts.clear();
+            mLast = nullptr;
+            for (auto & s : segments)
+            {
+                if (!s.size || s.start + s.size < s.start)
+                    continue;
+                if (!mSegments.empty() && mSegments.back().start + mSegments.back().size > s.start)
+                    continue;
+                if (s.fileSize > s.size)
+                    s.fileSize = s.size;
+                if (s.fileSize && !mFile.At(s.offset, size_t(s.fileSize)))
+                    continue;
+                mSegments.push_back(s);
+                mStarts.push_back(s.start);
+            }
+        }
+
+    private:
+        std::vector<Segment> mSegments; //Sorted by start
+        std::vector<duint> mStarts;
+        const Segment* mLast = nullptr;
+
+        //Segment whose file backed part contains address
+        const Segment* find(duint address)
+        {
+            if (mLast && address >= mLast->start && address - mLast->start < mLast->fileSize)
+                return mLast;
+            auto i = std::upper_bound(mStarts.begin(), mStarts.end(), address) - mStarts.begin();
+            if (!i || address - mSegments[i - 1].start >= mSegments[i - 1].fileSize)
+                return nullptr;
+            return mLast = &mSegments[i - 1];
+        }
+    };
+
+    //ELF core file (ET_CORE, little endian, 32 or 64 bit): the PT_LOAD program headers are the memory.
+    struct ElfCoreReader : DumpReader
+    {
+        bool Open(const std::string & path)
+        {
+            Close();
+            if (!mFile.Open(path))
+                return false;
+            auto ident = mFile.At(0, 16);
+            if (!ident || memcmp(ident, "\x7F" "ELF", 4) != 0 || ident[5] != 1) //ELFDATA2LSB
+                return fail();
+            auto is64 = ident[4] == 2; //ELFCLASS64
+            if (!is64 && ident[4] != 1)
+                return fail();
+            if (read<unsigned short>(16) != 4) //ET_CORE
+                return fail();
+
+            unsigned long long phoff = is64 ? read<unsigned long long>(32) : read<unsigned int>(28);
+            size_t phentsize = read<unsigned short>(is64 ? 54 : 42);
+            size_t phnum = read<unsigned short>(is64 ? 56 : 44);
+            if (phnum == 0xFFFF) //PN_XNUM: the real count is sh_info of section header 0
+            {
+                unsigned long long shoff = is64 ? read<unsigned long long>(40) : read<unsigned int>(32);
+                if (!shoff || !mFile.At(shoff + (is64 ? 44 : 28), 4))
+                    return fail();
+                phnum = read<unsigned int>(shoff + (is64 ? 44 : 28));
+            }
+            if (phentsize < (is64 ? 56u : 32u) || phnum > mFile.Size() / phentsize || !mFile.At(phoff, phentsize * phnum))
+                return fail();
+
+            std::vector<Segment> segments;
+            for (size_t i = 0; i < phnum; i++)
+            {
+                auto ph = phoff + i * phentsize;
+                if (read<unsigned int>(ph) != 1) //PT_LOAD
+                    continue;
+                Segment s;
+                unsigned int flags;
+                if (is64)
+                {
+                    flags = read<unsigned int>(ph + 4);
+                    s.offset = read<unsigned long long>(ph + 8);
+                    s.start = duint(read<unsigned long long>(ph + 16));
+                    s.fileSize = duint(read<unsigned long long>(ph + 32));
+                    s.size = duint(read<unsigned long long>(ph + 40));
+                }
+                else
+                {
+                    s.offset = read<unsigned int>(ph + 4);
+                    s.start = read<unsigned int>(ph + 8);
+                    s.fileSize = read<unsigned int>(ph + 16);
+                    s.size = read<unsigned int>(ph + 20);
+                    flags = read<unsigned int>(ph + 24);
+                }
+                s.protection = 0;
+                if (flags & 4) //PF_R
+                    s.protection |= Region::Read;
+                if (flags & 2) //PF_W
+                    s.protection |= Region::Write;
+                if (flags & 1) //PF_X
+                    s.protection |= Region::Execute;
+                segments.push_back(s);
+            }
+            addSegments(segments);
+            if (Segments().empty())
+                return fail();
+            mWideCharSize = 4; //ELF targets use UTF-32 wchar_t
+            return true;
+        }
+
+    };
+
+    //Raw memory image: the file (or parts of it) mapped at known virtual addresses.
+    struct RawImageReader : DumpReader
+    {
+        //The whole file is the memory starting at base
+        bool Open(const std::string & path, duint base, int wideCharSize = int(sizeof(wchar_t)))
+        {
+            Close();
+            if (!mFile.Open(path))
+                return false;
+            std::vector<Segment> segments(1);
+            segments[0].start = base;
+            segments[0].size = segments[0].fileSize = duint(mFile.Size());
+            segments[0].protection = Region::Read | Region::Write;
+            addSegments(segments);
+            mWideCharSize = wideCharSize;
+            if (Segments().empty())
+                return fail();
+            return true;
+        }
+
+        //Sparse image: each segment maps a file range (offset, fileSize) to a virtual address range. Invalid
+        //segments (empty, overlapping or past the end of the file) are dropped, Open fails if none is left.
+        bool Open(const std::string & path, std::vector<Segment> segments, int wideCharSize = int(sizeof(wchar_t)))
+        {
+            Close();
+            if (!mFile.Open(path))
+                return false;
+            addSegments(segments);
+            mWideCharSize = wideCharSize;
+            if (Segments().empty())
+                return fail();
+            return true;
+        }
+    };
+
+    //Windows minidump: memory comes from MINIDUMP_MEMORY64_LIST (full dumps) and MINIDUMP_MEMORY_LIST.
+    struct MinidumpReader : DumpReader
+    {
+        bool Open(const std::string & path)
+        {
+            Close();
+            if (!mFile.Open(path))
+                return false;
+            if (read<unsigned int>(0) != 0x504D444D) //MDMP
+                return fail();
+            size_t streams = read<unsigned int>(8);
+            unsigned long long directory = read<unsigned int>(12);
+            if (!mFile.At(directory, streams * 12))
+                return fail();
+
+            std::vector<Segment> segments;
+            for (size_t i = 0; i < streams; i++)
+            {
+                auto entry = directory + i * 12;
+                auto type = read<unsigned int>(entry);
+                unsigned long long rva = read<unsigned int>(entry + 8);
+                if (type == 9) //Memory64ListStream
+                {
+                    auto count = read<unsigned long long>(rva);
+                    auto offset = read<unsigned long long>(rva + 8); //ranges are stored back to back from here
+                    if (count > mFile.Size() / 16 || !mFile.At(rva + 16, size_t(count * 16)))
+                        return fail();
+                    for (unsigned long long j = 0; j < count; j++)
+                    {
+                        Segment s;
+                        s.start = duint(read<unsigned long long>(rva + 16 + j * 16));
+                        s.size = s.fileSize = duint(read<unsigned long long>(rva + 24 + j * 16));
+                        s.offset = offset;
+                        offset += s.size;
+                        segments.push_back(s);
+                    }
+                }
+                else if (type == 5) //MemoryListStream
+                {
+                    size_t count = read<unsigned int>(rva);
+                    if (count > mFile.Size() / 16 || !mFile.At(rva + 4, count * 16))
+                        return fail();
+                    for (size_t j = 0; j < count; j++)
+                    {
+                        auto descriptor = rva + 4 + j * 16;
+                        Segment s;
+                        s.start = duint(read<unsigned long long>(descriptor));
+                        s.size = s.fileSize = read<unsigned int>(descriptor + 8);
+                        s.offset = read<unsigned int>(descriptor + 12);
+                        segments.push_back(s);
+                    }
+                }
+            }
+            addSegments(segments);
+            if (Segments().empty())
+                return fail();
+            mWideCharSize = 2; //Windows targets use UTF-16 wchar_t
+            return true;
+        }
+    };
+};
\ No newline at end of file
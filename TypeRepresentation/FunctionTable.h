@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Types.h"
+#include <algorithm>
+
+namespace Types
+{
+    //Frozen snapshot of the functions for hot queries (is this call target noreturn?). Functions get dense handles
+    //(sorted by name), noreturn is a bitset and entry points are in an open addressing hash table.
+    //Rebuild after the TypeManager changes; reads are lock-free and safe from any number of threads.
+    struct FunctionTable
+    {
+        void Build(const TypeManager & t)
+        {
+            const auto & functions = t.Functions();
+            mNames.clear();
+            for (const auto & f : functions)
+                mNames.push_back(f.first);
+            std::sort(mNames.begin(), mNames.end());
+
+            auto count = mNames.size();
+            mNoReturn.assign((count + 63) / 64, 0);
+            mCallconv.assign(count, Cdecl);
+            size_t capacity = 16;
+            while (capacity < count * 2)
+                capacity *= 2;
+            mKeys.assign(capacity, 0);
+            mValues.assign(capacity, -1);
+            mShift = 64;
+            for (auto c = capacity; c > 1; c >>= 1)
+                mShift--;
+            for (size_t i = 0; i < count; i++)
+            {
+                const auto & f = functions.find(mNames[i])->second;
+                if (f.noreturn)
+                    mNoReturn[i / 64] |= 1ULL << (i % 64);
+                mCallconv[i] = (unsigned char)f.callconv;
+                if (!f.address)
+                    continue;
+                auto slot = bucket(f.address);
+                while (mKeys[slot] && mKeys[slot] != f.address)
+                    slot = (slot + 1) & (capacity - 1);
+                if (!mKeys[slot]) //aliases keep the first name
+                {
+                    mKeys[slot] = f.address;
+                    mValues[slot] = int(i);
+                }
+            }
+        }
+
+        int Count() const
+        {
+            return int(mNames.size());
+        }
+
+        //Handle of a function by name, -1 if unknown
+        int Find(const std::string & name) const
+        {
+            auto found = std::lower_bound(mNames.begin(), mNames.end(), name);
+            return found != mNames.end() && *found == name ? int(found - mNames.begin()) : -1;
+        }
+
+        //Handle of the function with this entry point, -1 if unknown
+        int FindAddress(unsigned long long address) const
+        {
+            if (!address || mKeys.empty())
+                return -1;
+            auto mask = mKeys.size() - 1;
+            for (auto slot = bucket(address); mKeys[slot]; slot = (slot + 1) & mask)
+                if (mKeys[slot] == address)
+                    return mValues[slot];
+            return -1;
+        }
+
+        //Function identifier, empty for an invalid handle
+        const std::string & Name(int handle) const
+        {
+            return size_t(handle) < mNames.size() ? mNames[size_t(handle)] : mNoName;
+        }
+
+        bool NoReturn(int handle) const
+        {
+            return size_t(handle) < mNames.size() && (mNoReturn[size_t(handle) / 64] >> (handle % 64) & 1);
+        }
+
+        bool NoReturnAt(unsigned long long address) const
+        {
+            return NoReturn(FindAddress(address));
+        }
+
+        //Calling convention, Cdecl for an invalid handle
+        CallingConvention Callconv(int handle) const
+        {
+            return size_t(handle) < mCallconv.size() ? CallingConvention(mCallconv[size_t(handle)]) : Cdecl;
+        }
+
+    private:
+        std::vector<std::string> mNames; //Handle -> function identifier
+        std::string mNoName; //Name of invalid handles
+        std::vector<unsigned long long> mNoReturn; //Bit per handle
+        std::vector<unsigned char> mCallconv; //CallingConvention per handle
+        std::vector<unsigned long long> mKeys; //Entry points (0 is an empty slot)
+        std::vector<int> mValues; //Handle per slot
+        int mShift = 64;
+
+        size_t bucket(unsigned long long address) const
+        {
+            return size_t((address * 0x9E3779B97F4A7C15ULL) >> mShift);
+        }
+    };
+};
\ No newline at end of file
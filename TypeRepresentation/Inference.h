@@ -0,0 +1,310 @@
+#pragma once
+
+#include "Types.h"
+#include "Memory.h"
+#include <set>
+
+namespace Types
+{
+    struct InferredField
+    {
+        std::string name; //field_<offset> (padding_<offset> for bytes that were zero in every sample)
+        std::string type; //Type.name
+        int offset = 0; //Offset in bytes
+        int size = 0; //Size in bytes (of the whole array for padding)
+        int arrsize = 0; //Number of elements for padding
+        double confidence = 0; //Fraction of the samples that agree with the type
+    };
+
+    //Proposes a struct layout from sample instances. The samples are transposed into one column per offset so
+    //each candidate type is tested with branch-free counting loops over all samples at once.
+    struct LayoutInference
+    {
+        //regions tells which values are pointers (and which pointers are strings), size is the struct size.
+        //Pointers of a target with another pointer size than the host are typed uint32/uint64.
+        //Limits: bytes that are zero in every sample become padding, including pointers that are null in all of
+        //them. Fields are only found at offsets aligned to their size. An integer is only typed long long when
+        //its high half carries the value of its low half (a small high half next to a large low half, or a sign
+        //extension), and short when its high byte is set, otherwise the value is split into smaller fields
+        //(long long into two ints, short into a char and padding). 4 bytes are only split into two shorts when
+        //both halves are small and the whole is not, so ambiguous values stay int.
+        static bool Infer(MemoryReader & reader, const RegionMap & regions, const std::vector<duint> & samples, int size, std::vector<InferredField> & fields, int pointerSize = int(sizeof(void*)))
+        {
+            fields.clear();
+            if (size <= 0 || (pointerSize != 4 && pointerSize != 8))
+                return false;
+            std::vector<unsigned char> rows;
+            std::vector<unsigned char> row(size_t(size), 0);
+            for (auto s : samples)
+                if (reader.Read(s, row.data(), row.size()))
+                    rows.insert(rows.end(), row.begin(), row.end());
+            auto n = rows.size() / size_t(size);
+            if (!n)
+                return false;
+
+            Inference inference(reader, regions, rows, n, size_t(size));
+            auto padding = -1;
+            auto flush = [&](int offset)
+            {
+                if (padding < 0)
+                    return;
+                auto f = field("padding_", "char", padding, offset - padding, 1);
+                f.arrsize = f.size;
+                fields.push_back(f);
+                padding = -1;
+            };
+            for (auto offset = 0; offset < size;)
+            {
+                InferredField f;
+                auto classified = (offset % 8 == 0 && offset + 8 <= size && inference.wide(offset, pointerSize, f)) ||
+                                  (offset % 4 == 0 && offset + 4 <= size && inference.narrow(offset, pointerSize, f)) ||
+                                  (offset % 2 == 0 && offset + 2 <= size && inference.half(offset, f));
+                if (!classified)
+                {
+                    f.size = 1;
+                    if (!inference.zero(offset, 1))
+                        f = field("field_", "char", offset, 1, 1);
+                }
+                if (f.type.empty())
+                {
+                    //zero in every sample
+                    if (padding < 0)
+                        padding = offset;
+                    offset += f.size;
+                    continue;
+                }
+                flush(offset);
+                fields.push_back(f);
+                offset += f.size;
+            }
+            flush(size);
+            return true;
+        }
+
+        //Registers the fields as struct name (members at their inferred offsets). The fields are checked against
+        //the TypeManager first, so nothing is registered if any of them does not fit.
+        static bool Register(TypeManager & t, const std::string & owner, const std::string & name, const std::vector<InferredField> & fields)
+        {
+            if (owner.empty() || name.empty() || t.FindType(name) || t.FindStruct(name))
+                return false;
+            std::set<std::string> names;
+            auto end = 0;
+            for (const auto & f : fields)
+            {
+                auto size = t.Sizeof(f.type);
+                if (!size || f.type == name || f.arrsize < 0 || f.offset < end || !names.insert(f.name).second)
+                    return false;
+                end = f.offset + size * (f.arrsize ? f.arrsize : 1);
+            }
+            if (!t.AddStruct(owner, name))
+                return false;
+            for (const auto & f : fields)
+                if (!t.AddMember(name, f.name, f.type, f.arrsize, f.offset))
+                    return false;
+            return true;
+        }
+
+    private:
+        struct Inference
+        {
+            Inference(MemoryReader & reader, const RegionMap & regions, const std::vector<unsigned char> & rows, size_t count, size_t size)
+                : reader(reader), regions(regions), rows(rows), count(count), size(size), column(count)
+            {
+                const auto & r = regions.Regions();
+                low = r.empty() ? 0 : r.front().start;
+                high = r.empty() ? 0 : r.back().end;
+            }
+
+            //Pointer, string, double or 64-bit integer in 8 bytes
+            bool wide(int offset, int pointerSize, InferredField & f)
+            {
+                load(offset, 8);
+                auto zeros = countZero();
+                if (zeros == count)
+                {
+                    f.size = 8;
+                    return true;
+                }
+                if (pointerSize == 8 && pointers(zeros, f, offset, 8))
+                    return true;
+                //finite doubles of a plausible magnitude (about 1e-9 to 1e12)
+                size_t doubles = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    auto exponent = (column[i] >> 52) & 0x7FF;
+                    doubles += column[i] && exponent >= 1023 - 30 && exponent <= 1023 + 40;
+                }
+                if (doubles && doubles + zeros == count && doubles * 5 >= (count - zeros) * 4)
+                {
+                    f = field("field_", "double", offset, 8, double(doubles + zeros) / count);
+                    return true;
+                }
+                //the high half only extends the low half: small next to a large low half, or all ones for a
+                //negative value. A small low half next to a set high half looks like two ints.
+                size_t wides = 0, negatives = 0, splits = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    auto high = column[i] >> 32, low = column[i] & 0xFFFFFFFF;
+                    auto negative = high == 0xFFFFFFFF && low >= 0x80000000;
+                    wides += high && high < 0x10000 && low >= 0x10000;
+                    negatives += negative;
+                    splits += high && !negative && (high >= 0x10000 || low < 0x10000);
+                }
+                if (!(wides + negatives) || splits)
+                    return false;
+                f = field("field_", negatives ? "long long" : "unsigned long long", offset, 8, 1);
+                return true;
+            }
+
+            //Pointer (32-bit targets), float or integer in 4 bytes
+            bool narrow(int offset, int pointerSize, InferredField & f)
+            {
+                load(offset, 4);
+                auto zeros = countZero();
+                if (zeros == count)
+                {
+                    f.size = 4;
+                    return true;
+                }
+                if (pointerSize == 4 && pointers(zeros, f, offset, 4))
+                    return true;
+                size_t floats = 0, small = 0, halves = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    auto exponent = (column[i] >> 23) & 0xFF;
+                    floats += column[i] && exponent >= 127 - 20 && exponent <= 127 + 30;
+                    small += column[i] + 0x10000 <= 0x20000 || column[i] >= 0xFFFF0000ULL; //-65536..65536
+                    halves += short16(column[i] & 0xFFFF) && short16(column[i] >> 16);
+                }
+                if (floats && floats + zeros == count)
+                    f = field("field_", "float", offset, 4, 1);
+                else if (small < count && halves == count)
+                    return false; //two shorts
+                else
+                    f = field("field_", small == count ? "int" : "unsigned int", offset, 4, double(small > count / 2 ? small : count - small) / count);
+                return true;
+            }
+
+            //16-bit integer with its high byte set in some sample (otherwise it is left to char)
+            bool half(int offset, InferredField & f)
+            {
+                load(offset, 2);
+                auto zeros = countZero();
+                if (zeros == count)
+                {
+                    f.size = 2;
+                    return true;
+                }
+                size_t high = 0, small = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    high += column[i] >= 0x100;
+                    small += short16(column[i]);
+                }
+                if (!high)
+                    return false;
+                f = field("field_", small == count ? "short" : "unsigned short", offset, 2, double(small > count / 2 ? small : count - small) / count);
+                return true;
+            }
+
+            bool zero(int offset, int bytes)
+            {
+                load(offset, bytes);
+                return countZero() == count;
+            }
+
+        private:
+            MemoryReader & reader;
+            const RegionMap & regions;
+            const std::vector<unsigned char> & rows;
+            size_t count;
+            size_t size;
+            std::vector<unsigned long long> column; //Values at one offset, one per sample
+            duint low; //Bounds of all regions, tested before looking a value up
+            duint high;
+
+            //Transposes bytes bytes at offset of every sample into column
+            void load(int offset, int bytes)
+            {
+                auto src = rows.data() + offset;
+                for (size_t i = 0; i < count; i++, src += size)
+                {
+                    unsigned long long value = 0;
+                    memcpy(&value, src, size_t(bytes));
+                    column[i] = value;
+                }
+            }
+
+            //-4096..4096 as a 16-bit value
+            static bool short16(unsigned long long value)
+            {
+                return value <= 0x1000 || (value >= 0xF000 && value <= 0xFFFF);
+            }
+
+            size_t countZero() const
+            {
+                size_t zeros = 0;
+                for (size_t i = 0; i < count; i++)
+                    zeros += column[i] == 0;
+                return zeros;
+            }
+
+            //Values that are null or point into readable memory, strings if most targets are printable text
+            bool pointers(size_t zeros, InferredField & f, int offset, int bytes)
+            {
+                size_t inside = 0;
+                for (size_t i = 0; i < count; i++)
+                    inside += column[i] >= low && column[i] < high;
+                if (inside + zeros < count)
+                    return false;
+                size_t valid = 0, strings = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    if (!column[i])
+                        continue;
+                    auto r = regions.Find(duint(column[i]));
+                    if (!r || !(r->protection & Region::Read))
+                        return false;
+                    valid++;
+                    strings += text(duint(column[i]));
+                }
+                auto isString = strings * 5 >= valid * 4;
+                const char* type = isString ? "char*" : "ptr";
+                if (bytes != int(sizeof(void*)))
+                    type = bytes == 4 ? "uint32" : "uint64"; //pointers of another target are registered as addresses
+                f = field("field_", type, offset, bytes, double(isString ? strings + zeros : count) / count);
+                return true;
+            }
+
+            //At least 4 printable characters followed by more of them or the terminator
+            bool text(duint address)
+            {
+                unsigned char chars[5];
+                if (!reader.Read(address, chars, sizeof(chars)))
+                    return false;
+                for (auto i = 0; i < 5; i++)
+                {
+                    auto ch = chars[i];
+                    if (i == 4 && !ch)
+                        return true;
+                    if ((ch < 0x20 && ch != '\t' && ch != '\n' && ch != '\r') || ch == 0x7F)
+                        return false;
+                }
+                return true;
+            }
+        };
+
+        static InferredField field(const char* prefix, const char* type, int offset, int size, double confidence)
+        {
+            char name[32] = "";
+            sprintf_s(name, "%s%X", prefix, offset);
+            InferredField f;
+            f.name = name;
+            f.type = type;
+            f.offset = offset;
+            f.size = size;
+            f.confidence = confidence;
+            return f;
+        }
+    };
+};
\ No newline at end of file
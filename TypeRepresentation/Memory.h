@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace Types
+{
+    typedef uintptr_t duint;
+
+    struct Region
+    {
+        enum Protection
+        {
+            Read = 1,
+            Write = 2,
+            Execute = 4
+        };
+
+        duint start = 0; //First address
+        duint end = 0; //One past the last address
+        int protection = 0; //Protection flags
+        std::string name; //Mapped file or segment name
+    };
+
+    //Sorted, non-overlapping address ranges of a target (process or dump).
+    struct RegionMap
+    {
+        bool Add(duint start, duint size, int protection, const std::string & name = "")
+        {
+            if (!size || start + size < start)
+                return false;
+            auto i = std::upper_bound(mStarts.begin(), mStarts.end(), start) - mStarts.begin();
+            if (i && mRegions[i - 1].end > start)
+                return false;
+            if (size_t(i) < mStarts.size() && mStarts[i] < start + size)
+                return false;
+            Region r;
+            r.start = start;
+            r.end = start + size;
+            r.protection = protection;
+            r.name = name;
+            mStarts.insert(mStarts.begin() + i, start);
+            mRegions.insert(mRegions.begin() + i, r);
+            return true;
+        }
+
+        //Parses a /proc/<pid>/maps file (live or captured)
+        bool LoadProcMaps(const std::string & path)
+        {
+            std::ifstream file(path.c_str());
+            if (!file)
+                return false;
+            Clear();
+            std::string line;
+            while (std::getline(file, line))
+            {
+                //start-end perms offset dev inode [name]
+                std::istringstream fields(line);
+                std::string range, perms, offset, dev, inode, name;
+                if (!(fields >> range >> perms >> offset >> dev >> inode))
+                    continue;
+                std::getline(fields >> std::ws, name);
+                char* end = nullptr;
+                auto start = duint(strtoull(range.c_str(), &end, 16));
+                if (*end != '-')
+                    continue;
+                auto last = duint(strtoull(end + 1, nullptr, 16));
+                auto protection = 0;
+                if (perms.find('r') != std::string::npos)
+                    protection |= Region::Read;
+                if (perms.find('w') != std::string::npos)
+                    protection |= Region::Write;
+                if (perms.find('x') != std::string::npos)
+                    protection |= Region::Execute;
+                if (last > start)
+                    Add(start, last - start, protection, name);
+            }
+            return true;
+        }
+
+        bool LoadProcMaps(int pid = 0)
+        {
+            if (!pid)
+                return LoadProcMaps(std::string("/proc/self/maps"));
+            char path[64] = "";
+            sprintf_s(path, "/proc/%d/maps", pid);
+            return LoadProcMaps(std::string(path));
+        }
+
+        //Mappings of the current process (VirtualQuery on Windows, /proc/self/maps elsewhere)
+        bool LoadCurrentProcess()
+        {
+#ifdef _WIN32
+            Clear();
+            MEMORY_BASIC_INFORMATION info;
+            for (duint address = 0; VirtualQuery((LPCVOID)address, &info, sizeof(info)) == sizeof(info); )
+            {
+                auto start = duint(info.BaseAddress);
+                auto size = duint(info.RegionSize);
+                auto protect = info.Protect & 0xFF;
+                if (info.State == MEM_COMMIT && protect != PAGE_NOACCESS && protect != PAGE_EXECUTE && !(info.Protect & PAGE_GUARD))
+                {
+                    auto protection = Region::Read;
+                    if (protect == PAGE_READWRITE || protect == PAGE_WRITECOPY || protect == PAGE_EXECUTE_READWRITE || protect == PAGE_EXECUTE_WRITECOPY)
+                        protection |= Region::Write;
+                    if (protect == PAGE_EXECUTE_READ || protect == PAGE_EXECUTE_READWRITE || protect == PAGE_EXECUTE_WRITECOPY)
+                        protection |= Region::Execute;
+                    Add(start, size, protection);
+                }
+                if (start + size <= address)
+                    break; //wrapped around
+                address = start + size;
+            }
+            return !Empty();
+#else
+            return LoadProcMaps();
+#endif
+        }
+
+        const Region* Find(duint address) const
+        {
+            auto i = std::upper_bound(mStarts.begin(), mStarts.end(), address) - mStarts.begin();
+            if (!i || mRegions[i - 1].end <= address)
+                return nullptr;
+            return &mRegions[i - 1];
+        }
+
+        const std::vector<Region> & Regions() const
+        {
+            return mRegions;
+        }
+
+        bool Empty() const
+        {
+            return mRegions.empty();
+        }
+
+        void Clear()
+        {
+            mStarts.clear();
+            mRegions.clear();
+        }
+
+    private:
+        std::vector<duint> mStarts; //Region starts, searched separately to keep the binary search cache friendly
+        std::vector<Region> mRegions;
+    };
+
+    //Source of target memory for the visitors.
+    struct MemoryReader
+    {
+        virtual ~MemoryReader() { }
+
+        //Reads size bytes at address, fails if any of them is not readable
+        virtual bool Read(duint address, void* buffer, size_t size) = 0;
+
+        //Checks whether size bytes at address can be read
+        virtual bool IsValid(duint address, size_t size) = 0;
+
+        //Zero-copy access to size bytes at address, nullptr if the reader cannot provide a stable pointer
+        virtual const void* Map(duint address, size_t size)
+        {
+            return nullptr;
+        }
+
+        //Starts reading the range in the background, true if it can already be read without blocking
+        virtual bool Prefetch(duint address, size_t size)
+        {
+            return true;
+        }
+
+        //Size of a wchar_t in the target (2 for Windows targets, 4 for most others)
+        virtual int WideCharSize()
+        {
+            return int(sizeof(wchar_t));
+        }
+    };
+
+    //Reads the current process. Every access is checked against a region map first, with the last
+    //matching region cached since visits tend to stay inside one allocation. A region map passed in must
+    //not change while the reader uses it; without one the reader loads the mappings of the current
+    //process itself and reloads them when an address is not found (memory may have been mapped since),
+    //at most once per RefreshInterval so garbage pointers stay cheap.
+    struct LocalMemoryReader : MemoryReader
+    {
+        static const int RefreshInterval = 100; //Milliseconds
+
+        explicit LocalMemoryReader(const RegionMap* regions = nullptr)
+            : mRegions(regions) { }
+
+        bool Read(duint address, void* buffer, size_t size) override
+        {
+            if (!IsValid(address, size))
+                return false;
+            memcpy(buffer, (const void*)address, size);
+            return true;
+        }
+
+        const void* Map(duint address, size_t size) override
+        {
+            return IsValid(address, size) ? (const void*)address : nullptr;
+        }
+
+        bool IsValid(duint address, size_t size) override
+        {
+            if (!address || address + size < address)
+                return false;
+            if (!mRegions && !mLoaded)
+                refresh();
+            auto end = address + size;
+            while (true)
+            {
+                const auto & regions = (mRegions ? *mRegions : mOwn).Regions();
+                auto last = mLast < regions.size() ? &regions[mLast] : nullptr;
+                if (!last || address < last->start || address >= last->end)
+                {
+                    last = find(address);
+                    if (!last)
+                        return false;
+                }
+                if (!(last->protection & Region::Read))
+                    return false;
+                if (end <= last->end)
+                    return true;
+                address = last->end; //the range continues in the next region
+            }
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        const RegionMap* mRegions;
+        RegionMap mOwn; //Mappings of the current process if no region map was passed
+        bool mLoaded = false;
+        Clock::time_point mLoadTime;
+        size_t mLast = size_t(-1); //Index of the last matching region
+
+        const Region* find(duint address)
+        {
+            const auto & map = mRegions ? *mRegions : mOwn;
+            auto found = map.Find(address);
+            if (!found && !mRegions && refresh())
+                found = mOwn.Find(address);
+            if (found)
+                mLast = size_t(found - map.Regions().data());
+            return found;
+        }
+
+        bool refresh()
+        {
+            auto now = Clock::now();
+            if (mLoaded && now - mLoadTime < std::chrono::milliseconds(int(RefreshInterval)))
+                return false;
+            mOwn.LoadCurrentProcess();
+            mLoaded = true;
+            mLoadTime = now;
+            mLast = size_t(-1);
+            return true;
+        }
+    };
+};
\ No newline at end of file
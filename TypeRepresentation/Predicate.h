@@ -0,0 +1,507 @@
+#pragma once
+
+#include "Types.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace Types
+{
+    //Predicate over the fields of a struct, compiled against its layout and evaluated on arrays of instances.
+    //Grammar: expr := and ('||' and)*, and := unary ('&&' unary)*, unary := '!' unary | '(' expr ')' | test,
+    //test := path [('==' | '!=' | '<' | '<=' | '>' | '>=' | '&') number]. A bare path tests for != 0 and
+    //'&' tests for any common bit. Paths are Field paths (e.g. p, e.c, e.d[1]).
+    struct Predicate
+    {
+        bool Compile(TypeManager & t, const std::string & type, const std::string & expression)
+        {
+            mNodes.clear();
+            mRoot = -1;
+            mError.clear();
+            mLayout = t.GetLayout(type);
+            if (!mLayout)
+                return fail("undefined type " + type);
+            mStride = size_t(mLayout->size);
+            mExpr = expression;
+            mPos = 0;
+            if (!parseOr(mRoot))
+                return false;
+            skipSpace();
+            if (mPos != mExpr.size())
+                return fail("unexpected input");
+            return true;
+        }
+
+        const std::string & Error() const
+        {
+            return mError;
+        }
+
+        //Bit i of bitmap is set if instance i matches, returns the number of matches
+        size_t FilterBitmap(const void* base, size_t count, std::vector<unsigned long long> & bitmap, size_t stride = 0) const
+        {
+            bitmap.assign((count + 63) / 64, 0);
+            if (mNodes.empty() || !base)
+                return 0;
+            if (!stride)
+                stride = mStride;
+            std::vector<unsigned long long> scratch(mNodes.size() * BlockWords);
+            size_t matches = 0;
+            for (size_t row = 0; row < count; row += BlockRows)
+            {
+                auto rows = count - row < BlockRows ? count - row : BlockRows;
+                auto words = (rows + 63) / 64;
+                auto result = evaluate(mRoot, (const unsigned char*)base + row * stride, stride, rows, scratch);
+                for (size_t w = 0; w < words; w++)
+                {
+                    bitmap[row / 64 + w] = result[w];
+                    matches += popcount(result[w]);
+                }
+            }
+            return matches;
+        }
+
+        size_t FilterIndices(const void* base, size_t count, std::vector<size_t> & indices, size_t stride = 0) const
+        {
+            std::vector<unsigned long long> bitmap;
+            indices.clear();
+            indices.reserve(FilterBitmap(base, count, bitmap, stride));
+            for (size_t w = 0; w < bitmap.size(); w++)
+            {
+                for (auto bits = bitmap[w]; bits; bits &= bits - 1)
+                    indices.push_back(w * 64 + lowestBit(bits));
+            }
+            return indices.size();
+        }
+
+        //Index of the lowest set bit of a nonzero bitmap word
+        static size_t lowestBit(unsigned long long x)
+        {
+            size_t i = 0;
+            while (!(x & 0xFFFFFFFF))
+            {
+                x >>= 32;
+                i += 32;
+            }
+            while (!(x & 1))
+            {
+                x >>= 1;
+                i++;
+            }
+            return i;
+        }
+
+    private:
+        enum Op
+        {
+            And,
+            Or,
+            Not,
+            Equal,
+            NotEqual,
+            Less,
+            LessEqual,
+            Greater,
+            GreaterEqual,
+            BitTest,
+            Constant
+        };
+
+        enum Domain
+        {
+            Signed,
+            Unsigned,
+            Real
+        };
+
+        struct Node
+        {
+            Op op;
+            int left = -1; //Child node indices (And/Or/Not)
+            int right = -1;
+            Field field;
+            Domain domain = Unsigned;
+            long long s = 0;
+            unsigned long long u = 0;
+            double d = 0;
+            bool constant = false;
+        };
+
+        static const size_t BlockWords = 16;
+        static const size_t BlockRows = BlockWords * 64;
+
+        const Layout* mLayout = nullptr;
+        size_t mStride = 0;
+        std::vector<Node> mNodes;
+        int mRoot = -1;
+        std::string mExpr;
+        size_t mPos = 0;
+        std::string mError;
+
+        bool fail(const std::string & error)
+        {
+            char pos[32] = "";
+            sprintf_s(pos, " at %d", int(mPos));
+            mError = error + pos;
+            mNodes.clear();
+            return false;
+        }
+
+        void skipSpace()
+        {
+            while (mPos < mExpr.size() && isspace((unsigned char)mExpr[mPos]))
+                mPos++;
+        }
+
+        bool next(const char* token)
+        {
+            skipSpace();
+            return mExpr.compare(mPos, strlen(token), token) == 0;
+        }
+
+        bool accept(const char* token)
+        {
+            if (!next(token))
+                return false;
+            mPos += strlen(token);
+            return true;
+        }
+
+        int addNode(Op op, int left = -1, int right = -1)
+        {
+            Node n;
+            n.op = op;
+            n.left = left;
+            n.right = right;
+            mNodes.push_back(n);
+            return int(mNodes.size() - 1);
+        }
+
+        bool parseOr(int & index)
+        {
+            int left;
+            if (!parseAnd(left))
+                return false;
+            while (accept("||"))
+            {
+                int right;
+                if (!parseAnd(right))
+                    return false;
+                left = addNode(Or, left, right);
+            }
+            index = left;
+            return true;
+        }
+
+        bool parseAnd(int & index)
+        {
+            int left;
+            if (!parseUnary(left))
+                return false;
+            while (accept("&&"))
+            {
+                int right;
+                if (!parseUnary(right))
+                    return false;
+                left = addNode(And, left, right);
+            }
+            index = left;
+            return true;
+        }
+
+        bool parseUnary(int & index)
+        {
+            if (accept("!"))
+            {
+                int child;
+                if (!parseUnary(child))
+                    return false;
+                index = addNode(Not, child);
+                return true;
+            }
+            if (accept("("))
+            {
+                if (!parseOr(index))
+                    return false;
+                return accept(")") || fail("expected )");
+            }
+            return parseTest(index);
+        }
+
+        bool parseTest(int & index)
+        {
+            skipSpace();
+            auto start = mPos;
+            while (mPos < mExpr.size() && (isalnum((unsigned char)mExpr[mPos]) || strchr("_.[]", mExpr[mPos])))
+                mPos++;
+            auto path = mExpr.substr(start, mPos - start);
+            if (path.empty())
+                return fail("expected field");
+            auto field = mLayout->FindField(path);
+            if (!field)
+                return fail("unknown field " + path);
+            if (field->bitsize)
+                return fail("bitfield " + path + " is not supported");
+            if (field->size != 1 && field->size != 2 && field->size != 4 && field->size != 8)
+                return fail("unsupported field size " + path);
+
+            Op op = NotEqual;
+            if (accept("=="))
+                op = Equal;
+            else if (accept("!="))
+                op = NotEqual;
+            else if (accept("<="))
+                op = LessEqual;
+            else if (accept(">="))
+                op = GreaterEqual;
+            else if (accept("<"))
+                op = Less;
+            else if (accept(">"))
+                op = Greater;
+            else if (!next("&&") && accept("&"))
+                op = BitTest;
+            else
+            {
+                index = addNode(NotEqual);
+                return literal(mNodes[index], *field, "0");
+            }
+
+            skipSpace();
+            start = mPos;
+            while (mPos < mExpr.size() && (isalnum((unsigned char)mExpr[mPos]) || strchr("+-.", mExpr[mPos])))
+                mPos++;
+            if (start == mPos)
+                return fail("expected number");
+            index = addNode(op);
+            return literal(mNodes[index], *field, mExpr.substr(start, mPos - start));
+        }
+
+        bool literal(Node & n, const Field & field, const std::string & text)
+        {
+            n.field = field;
+            auto isReal = field.primitive == Float || field.primitive == Double;
+            auto isSigned = field.primitive == Int8 || field.primitive == Int16 || field.primitive == Int32 || field.primitive == Int64 || field.primitive == Dsint;
+            n.domain = isReal ? Real : isSigned ? Signed : Unsigned;
+
+            if (n.op == BitTest && isReal)
+                return fail("bit test needs an integer field");
+
+            char* end = nullptr;
+            auto str = text.c_str();
+            auto isFloat = text.find_first_of(".eE") != std::string::npos && text.find_first_of("xX") == std::string::npos;
+            if (isFloat || isReal)
+            {
+                auto d = strtod(str, &end);
+                if (*end)
+                    return fail("invalid number " + text);
+                if (n.domain != Real)
+                {
+                    if (n.op == BitTest)
+                        return fail("bit test needs an integer");
+                    n.domain = Real; //compare the integer field as double
+                }
+                n.d = d;
+                return true;
+            }
+
+            if (text[0] == '-')
+            {
+                auto s = strtoll(str, &end, 0);
+                if (*end)
+                    return fail("invalid number " + text);
+                if (n.domain == Unsigned && n.op != BitTest)
+                    return constant(n, n.op == NotEqual || n.op == Greater || n.op == GreaterEqual); //unsigned fields are never negative
+                n.s = s;
+                n.u = (unsigned long long)s; //bit tests use the two's complement pattern as the mask
+                return true;
+            }
+
+            auto u = strtoull(str, &end, 0);
+            if (*end)
+                return fail("invalid number " + text);
+            if (n.domain == Signed && u > 0x7FFFFFFFFFFFFFFFULL && n.op != BitTest)
+                return constant(n, n.op == NotEqual || n.op == Less || n.op == LessEqual);
+            n.u = u;
+            n.s = (long long)u;
+            return true;
+        }
+
+        bool constant(Node & n, bool value)
+        {
+            n.op = Constant;
+            n.constant = value;
+            return true;
+        }
+
+        const unsigned long long* evaluate(int index, const unsigned char* base, size_t stride, size_t rows, std::vector<unsigned long long> & scratch) const
+        {
+            const auto & n = mNodes[index];
+            auto out = scratch.data() + index * BlockWords;
+            auto words = (rows + 63) / 64;
+            switch (n.op)
+            {
+            case And:
+            case Or:
+            {
+                auto a = evaluate(n.left, base, stride, rows, scratch);
+                auto b = evaluate(n.right, base, stride, rows, scratch);
+                for (size_t w = 0; w < words; w++)
+                    out[w] = n.op == And ? a[w] & b[w] : a[w] | b[w];
+            }
+            break;
+            case Not:
+            {
+                auto a = evaluate(n.left, base, stride, rows, scratch);
+                for (size_t w = 0; w < words; w++)
+                    out[w] = ~a[w];
+            }
+            break;
+            case Constant:
+                for (size_t w = 0; w < words; w++)
+                    out[w] = n.constant ? ~0ULL : 0;
+                break;
+            default:
+                test(n, base + n.field.offset, stride, rows, out);
+                break;
+            }
+            if (rows % 64)
+                out[words - 1] &= (1ULL << (rows % 64)) - 1;
+            return out;
+        }
+
+        static void test(const Node & n, const unsigned char* src, size_t stride, size_t rows, unsigned long long* out)
+        {
+            if (n.domain == Real)
+            {
+                if (n.field.primitive == Float)
+                    compare<float, double>(n.op, src, stride, rows, n.d, out);
+                else if (n.field.primitive == Double)
+                    compare<double, double>(n.op, src, stride, rows, n.d, out);
+                else if (n.field.primitive == Int8 || n.field.primitive == Int16 || n.field.primitive == Int32 || n.field.primitive == Int64 || n.field.primitive == Dsint)
+                    convert<double>(n, src, stride, rows, n.d, true, out);
+                else
+                    convert<double>(n, src, stride, rows, n.d, false, out);
+            }
+            else if (n.domain == Signed)
+            {
+                switch (n.field.size)
+                {
+                case 1:
+                    compare<signed char, long long>(n.op, src, stride, rows, n.s, out);
+                    break;
+                case 2:
+                    compare<short, long long>(n.op, src, stride, rows, n.s, out);
+                    break;
+                case 4:
+                    compare<int, long long>(n.op, src, stride, rows, n.s, out);
+                    break;
+                default:
+                    compare<long long, long long>(n.op, src, stride, rows, n.s, out);
+                    break;
+                }
+            }
+            else
+            {
+                switch (n.field.size)
+                {
+                case 1:
+                    compare<unsigned char, unsigned long long>(n.op, src, stride, rows, n.u, out);
+                    break;
+                case 2:
+                    compare<unsigned short, unsigned long long>(n.op, src, stride, rows, n.u, out);
+                    break;
+                case 4:
+                    compare<unsigned int, unsigned long long>(n.op, src, stride, rows, n.u, out);
+                    break;
+                default:
+                    compare<unsigned long long, unsigned long long>(n.op, src, stride, rows, n.u, out);
+                    break;
+                }
+            }
+        }
+
+        template<typename A>
+        static void convert(const Node & n, const unsigned char* src, size_t stride, size_t rows, A literal, bool isSigned, unsigned long long* out)
+        {
+            switch (n.field.size)
+            {
+            case 1:
+                isSigned ? compare<signed char, A>(n.op, src, stride, rows, literal, out) : compare<unsigned char, A>(n.op, src, stride, rows, literal, out);
+                break;
+            case 2:
+                isSigned ? compare<short, A>(n.op, src, stride, rows, literal, out) : compare<unsigned short, A>(n.op, src, stride, rows, literal, out);
+                break;
+            case 4:
+                isSigned ? compare<int, A>(n.op, src, stride, rows, literal, out) : compare<unsigned int, A>(n.op, src, stride, rows, literal, out);
+                break;
+            default:
+                isSigned ? compare<long long, A>(n.op, src, stride, rows, literal, out) : compare<unsigned long long, A>(n.op, src, stride, rows, literal, out);
+                break;
+            }
+        }
+
+        template<typename T, typename A>
+        static void compare(Op op, const unsigned char* src, size_t stride, size_t rows, A literal, unsigned long long* out)
+        {
+            switch (op)
+            {
+            case Equal:
+                kernel<T, A>(src, stride, rows, out, [literal](A v) { return v == literal; });
+                break;
+            case NotEqual:
+                kernel<T, A>(src, stride, rows, out, [literal](A v) { return v != literal; });
+                break;
+            case Less:
+                kernel<T, A>(src, stride, rows, out, [literal](A v) { return v < literal; });
+                break;
+            case LessEqual:
+                kernel<T, A>(src, stride, rows, out, [literal](A v) { return v <= literal; });
+                break;
+            case Greater:
+                kernel<T, A>(src, stride, rows, out, [literal](A v) { return v > literal; });
+                break;
+            case GreaterEqual:
+                kernel<T, A>(src, stride, rows, out, [literal](A v) { return v >= literal; });
+                break;
+            case BitTest:
+                bitTest<T, A>(src, stride, rows, literal, out);
+                break;
+            default:
+                break;
+            }
+        }
+
+        template<typename T, typename A>
+        static void bitTest(const unsigned char* src, size_t stride, size_t rows, A literal, unsigned long long* out)
+        {
+            auto mask = (unsigned long long)(long long)literal;
+            kernel<T, A>(src, stride, rows, out, [mask](A v) { return ((unsigned long long)(long long)v & mask) != 0; });
+        }
+
+        //Branch-free block kernel: every row contributes one bit to its 64-bit word.
+        template<typename T, typename A, typename F>
+        static void kernel(const unsigned char* src, size_t stride, size_t rows, unsigned long long* out, F f)
+        {
+            for (size_t w = 0; w * 64 < rows; w++)
+            {
+                auto n = rows - w * 64 < 64 ? rows - w * 64 : 64;
+                unsigned long long bits = 0;
+                for (size_t i = 0; i < n; i++, src += stride)
+                {
+                    T v;
+                    memcpy(&v, src, sizeof(T));
+                    bits |= (unsigned long long)f(A(v)) << i;
+                }
+                out[w] = bits;
+            }
+        }
+
+        static size_t popcount(unsigned long long x)
+        {
+            x = x - ((x >> 1) & 0x5555555555555555ULL);
+            x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+            x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return size_t((x * 0x0101010101010101ULL) >> 56);
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,585 @@
+#pragma once
+
+#include "Types.h"
+#include "Memory.h"
+#include <deque>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Types
+{
+    //Synchronous reads of another process (/proc/<pid>/mem on Linux, ReadProcessMemory on Windows).
+    struct ProcessMemoryReader : MemoryReader
+    {
+        static const size_t PageSize = 0x1000;
+
+        ProcessMemoryReader() { }
+
+        ~ProcessMemoryReader()
+        {
+            Close();
+        }
+
+#ifdef _WIN32
+        bool Open(DWORD pid)
+        {
+            Close();
+            mProcess = OpenProcess(PROCESS_VM_READ | PROCESS_QUERY_INFORMATION, FALSE, pid);
+            return mProcess != nullptr;
+        }
+
+        void Close()
+        {
+            if (mProcess)
+                CloseHandle(mProcess);
+            mProcess = nullptr;
+        }
+
+        bool Read(duint address, void* buffer, size_t size) override
+        {
+            SIZE_T read = 0;
+            return mProcess && ReadProcessMemory(mProcess, (LPCVOID)address, buffer, size, &read) && read == size;
+        }
+
+        int WideCharSize() override
+        {
+            return 2;
+        }
+#else
+        bool Open(int pid)
+        {
+            Close();
+            char path[64] = "";
+            sprintf_s(path, "/proc/%d/mem", pid);
+            mFile = open(path, O_RDONLY);
+            return mFile >= 0;
+        }
+
+        void Close()
+        {
+            if (mFile >= 0)
+                close(mFile);
+            mFile = -1;
+        }
+
+        bool Read(duint address, void* buffer, size_t size) override
+        {
+            return mFile >= 0 && pread(mFile, buffer, size, off_t(address)) == ssize_t(size);
+        }
+
+        int Handle() const
+        {
+            return mFile;
+        }
+
+        int WideCharSize() override
+        {
+            return 4;
+        }
+#endif
+
+        //Memory is mapped in pages, so probing one byte per page is enough
+        bool IsValid(duint address, size_t size) override
+        {
+            if (!size || address + size < address)
+                return false;
+            auto last = (address + size - 1) & ~duint(PageSize - 1);
+            for (auto page = address & ~duint(PageSize - 1); ; page += PageSize)
+            {
+                unsigned char probe;
+                if (!Read(page < address ? address : page, &probe, 1))
+                    return false;
+                if (page == last)
+                    return true;
+            }
+        }
+
+    private:
+        ProcessMemoryReader(const ProcessMemoryReader &);
+        ProcessMemoryReader & operator=(const ProcessMemoryReader &);
+
+#ifdef _WIN32
+        HANDLE mProcess = nullptr;
+#else
+        int mFile = -1;
+#endif
+    };
+
+    //Reader that keeps many reads in flight and completes them out of order.
+    struct AsyncMemoryReader
+    {
+        struct Completion
+        {
+            unsigned long long tag; //Tag passed to Submit
+            bool success; //All bytes were read
+        };
+
+        virtual ~AsyncMemoryReader() { }
+
+        //Queues a read into buffer (which must stay valid until it completes), fails if the queue is full
+        virtual bool Submit(duint address, void* buffer, size_t size, unsigned long long tag) = 0;
+
+        //Starts the queued reads and appends the finished ones, waits for at least one if wait is set and reads are in flight
+        virtual size_t Poll(std::vector<Completion> & completions, bool wait) = 0;
+
+        //Submitted reads that did not complete yet
+        virtual size_t InFlight() const = 0;
+
+        virtual int WideCharSize()
+        {
+            return int(sizeof(wchar_t));
+        }
+    };
+
+    //Completes every read when it is submitted (for backends without asynchronous I/O such as dumps).
+    struct ImmediateReader : AsyncMemoryReader
+    {
+        explicit ImmediateReader(MemoryReader & reader)
+            : mReader(reader) { }
+
+        bool Submit(duint address, void* buffer, size_t size, unsigned long long tag) override
+        {
+            Completion c;
+            c.tag = tag;
+            c.success = mReader.Read(address, buffer, size);
+            mDone.push_back(c);
+            return true;
+        }
+
+        size_t Poll(std::vector<Completion> & completions, bool wait) override
+        {
+            auto count = mDone.size();
+            completions.insert(completions.end(), mDone.begin(), mDone.end());
+            mDone.clear();
+            return count;
+        }
+
+        size_t InFlight() const override
+        {
+            return mDone.size();
+        }
+
+        int WideCharSize() override
+        {
+            return mReader.WideCharSize();
+        }
+
+    private:
+        MemoryReader & mReader;
+        std::vector<Completion> mDone;
+    };
+
+#ifdef __linux__
+    //io_uring reads of /proc/<pid>/mem (IORING_OP_READ, Linux 5.6+). Set up through the raw system calls.
+    struct UringMemoryReader : AsyncMemoryReader
+    {
+        UringMemoryReader() { }
+
+        ~UringMemoryReader()
+        {
+            Close();
+        }
+
+        //Fails if the kernel (or a seccomp policy) does not allow io_uring, use ImmediateReader over a ProcessMemoryReader then
+        bool Open(int pid, unsigned entries = 64)
+        {
+            Close();
+            char path[64] = "";
+            sprintf_s(path, "/proc/%d/mem", pid);
+            mFile = open(path, O_RDONLY);
+            if (mFile < 0)
+                return false;
+
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            mRing = int(syscall(__NR_io_uring_setup, entries, &params));
+            if (mRing < 0)
+                return fail();
+
+            mSqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            mCqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single)
+                mSqSize = mCqSize = mSqSize > mCqSize ? mSqSize : mCqSize;
+            mSq = (unsigned char*)mmap(nullptr, mSqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_SQ_RING);
+            if (mSq == MAP_FAILED)
+                return mSq = nullptr, fail();
+            mCq = single ? mSq : (unsigned char*)mmap(nullptr, mCqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_CQ_RING);
+            if (mCq == MAP_FAILED)
+                return mCq = nullptr, fail();
+            mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            mSqes = (io_uring_sqe*)mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_SQES);
+            if (mSqes == MAP_FAILED)
+                return mSqes = nullptr, fail();
+
+            mSqHead = (unsigned*)(mSq + params.sq_off.head);
+            mSqTail = (unsigned*)(mSq + params.sq_off.tail);
+            mSqMask = *(unsigned*)(mSq + params.sq_off.ring_mask);
+            mSqArray = (unsigned*)(mSq + params.sq_off.array);
+            mCqHead = (unsigned*)(mCq + params.cq_off.head);
+            mCqTail = (unsigned*)(mCq + params.cq_off.tail);
+            mCqMask = *(unsigned*)(mCq + params.cq_off.ring_mask);
+            mCqes = (io_uring_cqe*)(mCq + params.cq_off.cqes);
+            mEntries = params.sq_entries;
+            mRequests.assign(mEntries, Request());
+            for (unsigned i = 0; i < mEntries; i++)
+                mFree.push_back(i);
+            return true;
+        }
+
+        void Close()
+        {
+            if (mSqes)
+                munmap(mSqes, mSqesSize);
+            if (mCq && mCq != mSq)
+                munmap(mCq, mCqSize);
+            if (mSq)
+                munmap(mSq, mSqSize);
+            if (mRing >= 0)
+                close(mRing);
+            if (mFile >= 0)
+                close(mFile);
+            mSqes = nullptr;
+            mSq = mCq = nullptr;
+            mRing = mFile = -1;
+            mRequests.clear();
+            mFree.clear();
+            mUnsubmitted = 0;
+        }
+
+        bool Submit(duint address, void* buffer, size_t size, unsigned long long tag) override
+        {
+            if (mRing < 0 || mFree.empty())
+                return false;
+            auto tail = *mSqTail;
+            if (tail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) >= mEntries)
+                return false;
+            auto slot = mFree.back();
+            mFree.pop_back();
+            mRequests[slot].tag = tag;
+            mRequests[slot].size = size;
+
+            auto index = tail & mSqMask;
+            auto & sqe = mSqes[index];
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = mFile;
+            sqe.addr = (unsigned long long)buffer;
+            sqe.len = unsigned(size);
+            sqe.off = (unsigned long long)address;
+            sqe.user_data = slot;
+            mSqArray[index] = index;
+            __atomic_store_n(mSqTail, tail + 1, __ATOMIC_RELEASE);
+            mUnsubmitted++;
+            return true;
+        }
+
+        size_t Poll(std::vector<Completion> & completions, bool wait) override
+        {
+            if (mRing < 0)
+                return 0;
+            wait = wait && InFlight();
+            if (mUnsubmitted || wait)
+            {
+                auto submitted = syscall(__NR_io_uring_enter, mRing, mUnsubmitted, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if (submitted > 0)
+                    mUnsubmitted -= unsigned(submitted);
+            }
+            size_t count = 0;
+            auto head = *mCqHead;
+            auto tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++, count++)
+            {
+                const auto & cqe = mCqes[head & mCqMask];
+                auto slot = unsigned(cqe.user_data);
+                Completion c;
+                c.tag = mRequests[slot].tag;
+                c.success = cqe.res >= 0 && size_t(cqe.res) == mRequests[slot].size;
+                completions.push_back(c);
+                mFree.push_back(slot);
+            }
+            __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+            return count;
+        }
+
+        size_t InFlight() const override
+        {
+            return mEntries - mFree.size();
+        }
+
+        int WideCharSize() override
+        {
+            return 4;
+        }
+
+    private:
+        UringMemoryReader(const UringMemoryReader &);
+        UringMemoryReader & operator=(const UringMemoryReader &);
+
+        struct Request
+        {
+            unsigned long long tag = 0;
+            size_t size = 0;
+        };
+
+        int mFile = -1;
+        int mRing = -1;
+        unsigned char* mSq = nullptr;
+        unsigned char* mCq = nullptr;
+        io_uring_sqe* mSqes = nullptr;
+        size_t mSqSize = 0;
+        size_t mCqSize = 0;
+        size_t mSqesSize = 0;
+        unsigned* mSqHead = nullptr;
+        unsigned* mSqTail = nullptr;
+        unsigned* mSqArray = nullptr;
+        unsigned mSqMask = 0;
+        unsigned* mCqHead = nullptr;
+        unsigned* mCqTail = nullptr;
+        unsigned mCqMask = 0;
+        io_uring_cqe* mCqes = nullptr;
+        unsigned mEntries = 0;
+        unsigned mUnsubmitted = 0;
+        std::vector<Request> mRequests; //Indexed by user_data
+        std::vector<unsigned> mFree;
+
+        bool fail()
+        {
+            Close();
+            return false;
+        }
+    };
+#endif
+
+    //Page cache over an asynchronous reader. Prefetch() queues the missing pages of a range without
+    //blocking, so a visit can have the targets of all pointers of a struct in flight at once.
+    //Read() blocks only for the pages it still needs. Call Flush() whenever the target runs.
+    struct PageCache : MemoryReader
+    {
+        static const size_t PageSize = 0x1000;
+
+        explicit PageCache(AsyncMemoryReader & reader, size_t maxPages = 0x10000)
+            : mReader(reader), mMaxPages(maxPages) { }
+
+        ~PageCache()
+        {
+            Flush();
+        }
+
+        //Queues the pages of the range that are neither cached nor in flight
+        bool Prefetch(duint address, size_t size) override
+        {
+            if (!size || address + size < address)
+                return true;
+            auto last = (address + size - 1) & ~duint(PageSize - 1);
+            for (auto page = address & ~duint(PageSize - 1); ; page += PageSize)
+            {
+                if (mPages.find(page) == mPages.end())
+                {
+                    if (mPages.size() >= mMaxPages)
+                        evict();
+                    auto & p = mPages[page];
+                    p.data.resize(PageSize);
+                    mQueue.push_back(page);
+                }
+                if (page == last)
+                    break;
+            }
+            submit();
+            return Ready(address, size);
+        }
+
+        //Whether all pages of the range completed (successfully or not)
+        bool Ready(duint address, size_t size)
+        {
+            if (!size || address + size < address)
+                return true;
+            auto last = (address + size - 1) & ~duint(PageSize - 1);
+            for (auto page = address & ~duint(PageSize - 1); ; page += PageSize)
+            {
+                auto found = mPages.find(page);
+                if (found == mPages.end() || found->second.state == Pending)
+                    return false;
+                if (page == last)
+                    return true;
+            }
+        }
+
+        //Processes finished reads, waits for at least one if wait is set and reads are in flight
+        size_t Pump(bool wait)
+        {
+            mCompletions.clear();
+            mReader.Poll(mCompletions, wait && mReader.InFlight());
+            for (const auto & c : mCompletions)
+            {
+                auto found = mPages.find(duint(c.tag));
+                if (found != mPages.end())
+                    found->second.state = c.success ? Valid : Invalid;
+            }
+            submit();
+            return mCompletions.size();
+        }
+
+        //Waits until the range is available (or known to be unreadable). Returns false at once for ranges
+        //larger than the cache, they never fit (Read handles them page by page).
+        bool Wait(duint address, size_t size)
+        {
+            if (!size || address + size < address)
+                return true;
+            auto pages = size_t((address + size - 1) / PageSize - address / PageSize) + 1;
+            if (pages > mMaxPages)
+                return false;
+            Prefetch(address, size);
+            while (!Ready(address, size))
+            {
+                Pump(true);
+                Prefetch(address, size); //completed pages of the range may have been evicted meanwhile
+            }
+            return true;
+        }
+
+        bool Read(duint address, void* buffer, size_t size) override
+        {
+            if (!size || address + size < address)
+                return false;
+            Prefetch(address, size);
+            auto dest = (unsigned char*)buffer;
+            while (size)
+            {
+                auto page = address & ~duint(PageSize - 1);
+                auto skip = size_t(address - page);
+                auto n = PageSize - skip < size ? PageSize - skip : size;
+                if (!Wait(page, PageSize)) //page by page, so reads larger than the cache work
+                    return false;
+                const auto & p = mPages[page];
+                if (p.state != Valid)
+                    return false;
+                memcpy(dest, p.data.data() + skip, n);
+                dest += n;
+                address += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool IsValid(duint address, size_t size) override
+        {
+            if (!size || address + size < address)
+                return false;
+            Prefetch(address, size);
+            auto last = (address + size - 1) & ~duint(PageSize - 1);
+            for (auto page = address & ~duint(PageSize - 1); ; page += PageSize)
+            {
+                if (!Wait(page, PageSize) || mPages[page].state != Valid)
+                    return false;
+                if (page == last)
+                    return true;
+            }
+        }
+
+        int WideCharSize() override
+        {
+            return mReader.WideCharSize();
+        }
+
+        //Queues the pointees of all typed pointer fields of an instance whose own bytes are already cached.
+        //Returns false if the instance is not cached yet.
+        bool PrefetchPointers(TypeManager & t, const std::string & type, duint address)
+        {
+            auto layout = t.GetLayout(type);
+            if (!layout || !Ready(address, size_t(layout->size)))
+                return false;
+            for (const auto & f : layout->fields)
+            {
+                if (f.primitive != Pointer)
+                    continue;
+                auto ptr = t.FindType(f.type);
+                if (!ptr || ptr->pointto.empty())
+                    continue;
+                duint value = 0;
+                if (Read(address + f.offset, &value, f.size < int(sizeof(value)) ? size_t(f.size) : sizeof(value)) && value)
+                    Prefetch(value, size_t(t.Sizeof(ptr->pointto)));
+            }
+            return true;
+        }
+
+        //Waits for the reads in flight and drops all pages
+        void Flush()
+        {
+            mQueue.clear();
+            while (mReader.InFlight())
+                Pump(true);
+            mPages.clear();
+        }
+
+    private:
+        enum State
+        {
+            Pending,
+            Valid,
+            Invalid
+        };
+
+        struct Page
+        {
+            State state = Pending;
+            std::vector<unsigned char> data; //Read target, its address is stable while the read is in flight
+        };
+
+        AsyncMemoryReader & mReader;
+        size_t mMaxPages;
+        std::unordered_map<duint, Page> mPages;
+        std::deque<duint> mQueue; //Pages waiting for a free submission slot
+        std::vector<AsyncMemoryReader::Completion> mCompletions;
+
+        void submit()
+        {
+            while (!mQueue.empty())
+            {
+                auto page = mQueue.front();
+                if (!mReader.Submit(page, mPages[page].data.data(), PageSize, page))
+                {
+                    if (mReader.InFlight())
+                        break; //retried when a completion frees a slot
+                    //nothing in flight can make room (closed reader, rejected request), so fail the queued pages
+                    //instead of leaving Wait to spin on them
+                    for (auto queued : mQueue)
+                    {
+                        auto found = mPages.find(queued);
+                        if (found != mPages.end())
+                            found->second.state = Invalid;
+                    }
+                    mQueue.clear();
+                    break;
+                }
+                mQueue.pop_front();
+            }
+        }
+
+        //Drops the completed pages (pages in flight have to stay where they are)
+        void evict()
+        {
+            for (auto i = mPages.begin(); i != mPages.end();)
+            {
+                if (i->second.state != Pending)
+                    i = mPages.erase(i);
+                else
+                    ++i;
+            }
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,339 @@
+#pragma once
+
+#include "Types.h"
+#include "Memory.h"
+#include "Predicate.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace Types
+{
+    struct ScanOptions
+    {
+        int alignment = 0; //Candidate alignment in bytes (0 = pointer size)
+        int protection = Region::Read | Region::Write; //Protection flags a region needs to be scanned
+        size_t chunk = 16 << 20; //Bytes of candidates per work item
+        size_t maxMatches = 0; //Keep the matches at the lowest addresses, chunks after them are skipped (0 = no limit)
+        int threads = 0; //Worker threads (0 = hardware concurrency)
+    };
+
+    //Finds likely instances of a type in all regions of a target. Candidates at every aligned address are first
+    //filtered by a Predicate over the whole chunk (bitmaps of 64 candidates at a time), the survivors are then
+    //checked against the pointer, enum and string constraints of their fields.
+    struct TypeScanner
+    {
+        //expression is a Predicate over the fields of type (value ranges, flags), it may be empty
+        bool Compile(TypeManager & t, const std::string & type, const std::string & expression = "")
+        {
+            mChecks.clear();
+            mError.clear();
+            mTypes = &t;
+            mLayout = t.GetLayout(type);
+            if (!mLayout || !mLayout->size)
+                return fail("undefined type " + type);
+            mPointerSize = t.Sizeof("ptr");
+            mHasPredicate = !expression.empty();
+            if (mHasPredicate && !mPredicate.Compile(t, type, expression))
+                return fail(mPredicate.Error());
+            return true;
+        }
+
+        //The pointer field has to point into a readable region
+        bool AddPointer(const std::string & path, bool allowNull = false)
+        {
+            return addCheck(path, allowNull ? Check::NullOrPointer : Check::Pointer, 0);
+        }
+
+        //The integer field has to hold a named value of its enum type (a combination of named bits for flags)
+        bool AddEnumValue(const std::string & path)
+        {
+            return addCheck(path, Check::EnumValue, 0);
+        }
+
+        //The String/WString field has to point to at least minLength printable code units (UTF-8 bytes for String)
+        bool AddString(const std::string & path, int minLength = 1)
+        {
+            return addCheck(path, Check::String, minLength > 0 ? minLength : 1);
+        }
+
+        const std::string & Error() const
+        {
+            return mError;
+        }
+
+        //Addresses of the matching candidates in ascending order. The reader is only used under a lock (a chunk
+        //at a time), so it does not need to be thread-safe; Map is used when it can provide the bytes in place.
+        bool Scan(MemoryReader & reader, const RegionMap & regions, std::vector<duint> & matches, const ScanOptions & options = ScanOptions())
+        {
+            matches.clear();
+            if (!mLayout)
+                return false;
+            auto align = size_t(options.alignment > 0 ? options.alignment : mPointerSize);
+            auto size = size_t(mLayout->size);
+            auto chunk = options.chunk / align * align;
+            if (!chunk)
+                chunk = align;
+
+            std::vector<Work> work;
+            for (const auto & r : regions.Regions())
+            {
+                if ((r.protection & options.protection) != options.protection || r.end - r.start < size)
+                    continue;
+                auto first = (r.start + align - 1) / align * align;
+                auto last = r.end - size; //last possible start
+                for (auto start = first; start <= last && start >= first; start += chunk)
+                {
+                    Work w;
+                    w.start = start;
+                    w.count = size_t(last - start) / align + 1;
+                    if (w.count > chunk / align)
+                        w.count = chunk / align;
+                    work.push_back(w);
+                }
+            }
+
+            size_t threads = options.threads > 0 ? size_t(options.threads) : size_t(std::thread::hardware_concurrency());
+            if (!threads)
+                threads = 1;
+            if (threads > work.size())
+                threads = work.size() ? work.size() : 1;
+
+            //work is in address order and every item keeps its own matches, so the result does not depend on
+            //which thread finishes first
+            Shared shared(reader, regions, options.maxMatches, work.size());
+            std::vector<std::vector<duint>> found(work.size());
+            auto worker = [&]()
+            {
+                std::vector<unsigned char> buffer;
+                for (auto i = shared.next++; i < shared.limit; i = shared.next++)
+                {
+                    scan(shared, work[i], align, buffer, found[i]);
+                    shared.finish(i, found[i].size());
+                }
+            };
+            if (threads == 1)
+                worker();
+            else
+            {
+                std::vector<std::thread> workers;
+                for (size_t i = 0; i < threads; i++)
+                    workers.push_back(std::thread(worker));
+                for (auto & w : workers)
+                    w.join();
+            }
+            for (const auto & f : found)
+                matches.insert(matches.end(), f.begin(), f.end());
+            if (options.maxMatches && matches.size() > options.maxMatches)
+                matches.resize(options.maxMatches);
+            return true;
+        }
+
+    private:
+        struct Check
+        {
+            enum Kind
+            {
+                Pointer,
+                NullOrPointer,
+                EnumValue,
+                String
+            };
+
+            Field field;
+            Kind kind = Pointer;
+            const Enum* enumeration = nullptr;
+            unsigned long long flags = 0; //All named bits of a flags enum
+            int minLength = 0;
+        };
+
+        struct Work
+        {
+            duint start = 0; //First candidate
+            size_t count = 0; //Candidates
+        };
+
+        struct Shared
+        {
+            Shared(MemoryReader & reader, const RegionMap & regions, size_t maxMatches, size_t items)
+                : reader(reader), regions(regions), maxMatches(maxMatches), wideCharSize(reader.WideCharSize()), limit(items), counts(items, size_t(-1)) { }
+
+            MemoryReader & reader;
+            const RegionMap & regions;
+            std::mutex lock; //Guards reader
+            std::atomic<size_t> next{ 0 }; //Next work item
+            size_t maxMatches;
+            int wideCharSize;
+            std::atomic<size_t> limit; //Work items from here on are not needed
+            std::mutex progress; //Guards counts, done and doneMatches
+            std::vector<size_t> counts; //Matches per finished work item, -1 while it is pending
+            size_t done = 0; //Work items before this one are all finished
+            size_t doneMatches = 0; //Matches in them
+
+            //Once the finished items at the lowest addresses hold maxMatches, the items after them are skipped
+            void finish(size_t item, size_t matches)
+            {
+                if (!maxMatches)
+                    return;
+                std::lock_guard<std::mutex> guard(progress);
+                counts[item] = matches;
+                while (done < counts.size() && counts[done] != size_t(-1))
+                    doneMatches += counts[done++];
+                if (doneMatches >= maxMatches && done < limit)
+                    limit = done;
+            }
+        };
+
+        TypeManager* mTypes = nullptr;
+        const Layout* mLayout = nullptr;
+        int mPointerSize = int(sizeof(void*));
+        bool mHasPredicate = false;
+        Predicate mPredicate;
+        std::vector<Check> mChecks;
+        std::string mError;
+
+        bool fail(const std::string & error)
+        {
+            mError = error;
+            mLayout = nullptr;
+            return false;
+        }
+
+        bool addCheck(const std::string & path, Check::Kind kind, int minLength)
+        {
+            auto field = mLayout ? mLayout->FindField(path) : nullptr;
+            if (!field)
+                return fail("unknown field " + path);
+            if (field->bitsize || field->size > 8)
+                return fail("field " + path + " is not supported");
+            Check c;
+            c.field = *field;
+            c.kind = kind;
+            c.minLength = minLength;
+            auto type = mTypes->FindType(field->type);
+            if (kind == Check::EnumValue)
+            {
+                c.enumeration = type ? type->enumeration : nullptr;
+                if (!c.enumeration)
+                    return fail("field " + path + " is not an enum");
+                for (auto v : c.enumeration->values)
+                    c.flags |= v;
+            }
+            else if (kind == Check::String)
+            {
+                if (field->primitive != Types::String && field->primitive != WString)
+                    return fail("field " + path + " is not a string");
+            }
+            else if (field->primitive != Types::Pointer && field->primitive != Types::String && field->primitive != WString)
+                return fail("field " + path + " is not a pointer");
+            mChecks.push_back(c);
+            return true;
+        }
+
+        void scan(Shared & shared, const Work & w, size_t align, std::vector<unsigned char> & buffer, std::vector<duint> & matches) const
+        {
+            auto bytes = (w.count - 1) * align + size_t(mLayout->size);
+            const unsigned char* data;
+            {
+                std::lock_guard<std::mutex> guard(shared.lock);
+                data = (const unsigned char*)shared.reader.Map(w.start, bytes);
+                if (!data)
+                {
+                    buffer.resize(bytes);
+                    if (!shared.reader.Read(w.start, buffer.data(), bytes))
+                        return;
+                    data = buffer.data();
+                }
+            }
+
+            std::vector<unsigned long long> bitmap;
+            if (mHasPredicate)
+                mPredicate.FilterBitmap(data, w.count, bitmap, align);
+            else
+            {
+                bitmap.assign((w.count + 63) / 64, ~0ULL);
+                if (w.count % 64)
+                    bitmap.back() = (1ULL << (w.count % 64)) - 1;
+            }
+
+            for (size_t word = 0; word < bitmap.size(); word++)
+            {
+                for (auto bits = bitmap[word]; bits; bits &= bits - 1)
+                {
+                    auto i = word * 64 + Predicate::lowestBit(bits);
+                    if (!check(shared, data + i * align))
+                        continue;
+                    matches.push_back(w.start + i * align);
+                    if (matches.size() == shared.maxMatches)
+                        return; //the rest of this item is at higher addresses
+                }
+            }
+        }
+
+        bool check(Shared & shared, const unsigned char* candidate) const
+        {
+            for (const auto & c : mChecks)
+            {
+                unsigned long long value = 0;
+                memcpy(&value, candidate + c.field.offset, size_t(c.field.size));
+                switch (c.kind)
+                {
+                case Check::NullOrPointer:
+                    if (!value)
+                        break;
+                    //fallthrough
+                case Check::Pointer:
+                    if (!readable(shared, duint(value)))
+                        return false;
+                    break;
+                case Check::EnumValue:
+                    if (!c.enumeration->Find(value) && !(c.enumeration->isflags && value && !(value & ~c.flags)))
+                        return false;
+                    break;
+                case Check::String:
+                    if (!printable(shared, duint(value), c.minLength, c.field.primitive == WString ? shared.wideCharSize : 1))
+                        return false;
+                    break;
+                }
+            }
+            return true;
+        }
+
+        static bool readable(Shared & shared, duint address)
+        {
+            auto r = shared.regions.Find(address);
+            return r && (r->protection & Region::Read);
+        }
+
+        static bool printable(Shared & shared, duint address, int minLength, int charSize)
+        {
+            if (!readable(shared, address))
+                return false;
+            unsigned char chars[256];
+            auto length = size_t(minLength) < sizeof(chars) / size_t(charSize) ? size_t(minLength) : sizeof(chars) / size_t(charSize);
+            {
+                std::lock_guard<std::mutex> guard(shared.lock);
+                if (!shared.reader.Read(address, chars, length * size_t(charSize)))
+                    return false;
+            }
+            for (size_t i = 0; i < length; i++)
+            {
+                unsigned int ch = 0;
+                memcpy(&ch, chars + i * size_t(charSize), size_t(charSize));
+                if ((ch < 0x20 && ch != '\t' && ch != '\n' && ch != '\r') || ch == 0x7F || ch > 0x10FFFF)
+                    return false;
+                if (charSize == 1 && ch > 0x7F)
+                {
+                    //UTF-8 sequence, it may be cut off at the end of the checked bytes
+                    auto trail = ch >= 0xF0 ? 3 : ch >= 0xE0 ? 2 : 1;
+                    if (ch < 0xC2 || ch > 0xF4)
+                        return false;
+                    for (; trail && i + 1 < length; trail--)
+                        if ((chars[++i] & 0xC0) != 0x80)
+                            return false;
+                }
+            }
+            return true;
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,320 @@
+#pragma once
+
+#include "Memory.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TYPES_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//The block search may load up to 15 bytes past the terminator, within a span the reader validated. AddressSanitizer
+//would report that as an overflow of the string object, so the search is not instrumented.
+#if defined(__clang__) || defined(__GNUC__)
+#define TYPES_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define TYPES_NO_SANITIZE_ADDRESS
+#endif
+
+namespace Types
+{
+    //Reads NUL-terminated strings of 1, 2 or 4 byte code units through a MemoryReader.
+    //Reads grow up to a page (bounded by the maximum length) and the terminator search is vectorized.
+    //Results are cached by address until Flush(), which should be called whenever the target runs.
+    struct StringReader
+    {
+        static const size_t PageSize = 0x1000;
+        static const size_t FirstChunk = 64; //Bytes of the first read of a string that cannot be mapped
+
+        explicit StringReader(MemoryReader* reader = nullptr, size_t maxLength = 255, size_t cacheSize = 256)
+            : mReader(reader), mMaxLength(maxLength)
+        {
+            size_t slots = 1;
+            while (slots < cacheSize)
+                slots <<= 1;
+            mCache.resize(cacheSize ? slots : 0);
+        }
+
+        void SetReader(MemoryReader* reader)
+        {
+            if (reader != mReader)
+                Flush();
+            mReader = reader;
+        }
+
+        //Maximum length in code units, longer strings are truncated
+        void SetMaxLength(size_t maxLength)
+        {
+            if (maxLength != mMaxLength)
+                Flush();
+            mMaxLength = maxLength;
+        }
+
+        size_t MaxLength() const
+        {
+            return mMaxLength;
+        }
+
+        void Flush()
+        {
+            for (auto & entry : mCache)
+                entry.used = false;
+        }
+
+        //Reads the code units (without terminator) as raw bytes, fails if nothing at address is readable
+        bool Read(duint address, int charSize, std::string & raw)
+        {
+            raw.clear();
+            if (!address || !mReader || (charSize != 1 && charSize != 2 && charSize != 4))
+                return false;
+
+            Entry* entry = nullptr;
+            if (!mCache.empty())
+            {
+                auto hash = (unsigned long long)(address ^ duint(charSize)) * 0x9E3779B97F4A7C15ULL;
+                entry = &mCache[size_t(hash >> 32) & (mCache.size() - 1)];
+                if (entry->used && entry->address == address && entry->charSize == charSize)
+                {
+                    raw = entry->raw;
+                    return entry->readable;
+                }
+            }
+
+            auto readable = read(address, size_t(charSize), raw);
+            if (entry)
+            {
+                entry->used = true;
+                entry->address = address;
+                entry->charSize = charSize;
+                entry->readable = readable;
+                entry->raw = raw;
+            }
+            return readable;
+        }
+
+        //Index of the first zero code unit in data (count if there is none). All count units have to be readable.
+        TYPES_NO_SANITIZE_ADDRESS static size_t FindTerminator(const unsigned char* data, size_t count, size_t charSize)
+        {
+            size_t i = 0;
+#ifdef TYPES_SSE2
+            const auto perBlock = 16 / charSize;
+            const auto zero = _mm_setzero_si128();
+            for (; i + perBlock <= count; i += perBlock)
+            {
+                auto block = _mm_loadu_si128((const __m128i*)(data + i * charSize));
+                auto eq = charSize == 1 ? _mm_cmpeq_epi8(block, zero) : charSize == 2 ? _mm_cmpeq_epi16(block, zero) : _mm_cmpeq_epi32(block, zero);
+                auto mask = (unsigned int)_mm_movemask_epi8(eq);
+                if (mask)
+                    return i + lowestBit(mask) / charSize;
+            }
+#endif
+            for (; i < count; i++)
+            {
+                auto unit = data + i * charSize;
+                if (!unit[0] && (charSize < 2 || !unit[1]) && (charSize < 4 || (!unit[2] && !unit[3])))
+                    return i;
+            }
+            return count;
+        }
+
+    private:
+        struct Entry
+        {
+            bool used = false;
+            bool readable = false;
+            duint address = 0;
+            int charSize = 0;
+            std::string raw;
+        };
+
+        MemoryReader* mReader;
+        size_t mMaxLength;
+        std::vector<Entry> mCache; //Direct mapped, power of two slots
+        std::vector<unsigned char> mBuffer;
+
+        //Memory the reader can map (the current process, mapped dumps) is searched in place and only the bytes up to
+        //the terminator are copied.
+        //Otherwise the string is read in chunks that start small and double up to the end of the page, so short
+        //strings do not pull in a whole page; after a failed read the chunk halves and is reset on the next page.
+        bool read(duint address, size_t charSize, std::string & raw)
+        {
+            auto limit = mMaxLength * charSize;
+            size_t scanned = 0; //code units already searched for the terminator
+            auto chunk = FirstChunk;
+            while (raw.size() < limit)
+            {
+                auto page = PageSize - size_t(address & (PageSize - 1));
+                if (page > limit - raw.size())
+                    page = limit - raw.size();
+                page = page / charSize * charSize;
+                if (!page) //a code unit straddles the page boundary
+                    page = charSize;
+
+                auto mapped = (const unsigned char*)mReader->Map(address, page);
+                if (mapped)
+                {
+                    //Map validated the whole span, the vectorized search stays inside it
+                    auto units = page / charSize;
+                    auto end = FindTerminator(mapped, units, charSize);
+                    raw.append((const char*)mapped, end * charSize);
+                    if (end < units)
+                        return true;
+                    address += page;
+                    scanned = raw.size() / charSize;
+                    continue;
+                }
+
+                auto size = page < chunk ? page : chunk;
+                mBuffer.resize(size);
+                if (!mReader->Read(address, mBuffer.data(), size))
+                {
+                    if (size <= charSize)
+                        return !raw.empty(); //the string runs into unreadable memory
+                    chunk = (size / 2 + charSize - 1) / charSize * charSize; //readable memory might end inside the page
+                    continue;
+                }
+                raw.append((const char*)mBuffer.data(), size);
+                address += size;
+                chunk = size == page ? FirstChunk : chunk * 2; //next page or the rest of this one
+
+                auto units = raw.size() / charSize;
+                auto end = scanned + FindTerminator((const unsigned char*)raw.data() + scanned * charSize, units - scanned, charSize);
+                if (end < units)
+                {
+                    raw.resize(end * charSize);
+                    return true;
+                }
+                scanned = units;
+            }
+            raw.resize(mMaxLength * charSize);
+            return true;
+        }
+
+        static unsigned int lowestBit(unsigned int mask)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return index;
+#else
+            return (unsigned int)__builtin_ctz(mask);
+#endif
+        }
+    };
+
+    //UTF-16/UTF-32 (little endian, unaligned) to UTF-8 with ASCII runs converted 8 code units at a time.
+    //Unpaired surrogates and invalid code points become U+FFFD.
+    struct Utf8
+    {
+        static void AppendUtf16(const unsigned char* data, size_t count, std::string & out)
+        {
+            size_t i = 0;
+            while (i < count)
+            {
+#ifdef TYPES_SSE2
+                const auto high = _mm_set1_epi16(short(0xFF80));
+                const auto zero = _mm_setzero_si128();
+                for (; i + 8 <= count; i += 8)
+                {
+                    auto block = _mm_loadu_si128((const __m128i*)(data + i * 2));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(block, high), zero)) != 0xFFFF)
+                        break;
+                    char ascii[16];
+                    _mm_storeu_si128((__m128i*)ascii, _mm_packus_epi16(block, block));
+                    out.append(ascii, 8);
+                }
+#endif
+                auto end = i + 8 < count ? i + 8 : count; //scalar until the next block boundary
+                while (i < end)
+                {
+                    unsigned int cp = unit16(data, i++);
+                    if (cp >= 0xD800 && cp <= 0xDBFF && i < count)
+                    {
+                        unsigned int low = unit16(data, i);
+                        if (low >= 0xDC00 && low <= 0xDFFF)
+                        {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                            i++;
+                        }
+                    }
+                    Append(out, cp);
+                }
+            }
+        }
+
+        static void AppendUtf32(const unsigned char* data, size_t count, std::string & out)
+        {
+            size_t i = 0;
+            while (i < count)
+            {
+#ifdef TYPES_SSE2
+                const auto high = _mm_set1_epi32(int(0xFFFFFF80));
+                const auto zero = _mm_setzero_si128();
+                for (; i + 8 <= count; i += 8)
+                {
+                    auto lo = _mm_loadu_si128((const __m128i*)(data + i * 4));
+                    auto hi = _mm_loadu_si128((const __m128i*)(data + i * 4 + 16));
+                    auto test = _mm_or_si128(_mm_and_si128(lo, high), _mm_and_si128(hi, high));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi32(test, zero)) != 0xFFFF)
+                        break;
+                    auto words = _mm_packs_epi32(lo, hi);
+                    char ascii[16];
+                    _mm_storeu_si128((__m128i*)ascii, _mm_packus_epi16(words, words));
+                    out.append(ascii, 8);
+                }
+#endif
+                auto end = i + 8 < count ? i + 8 : count;
+                for (; i < end; i++)
+                {
+                    unsigned int cp = unit16(data, i * 2) | unit16(data, i * 2 + 1) << 16;
+                    Append(out, cp);
+                }
+            }
+        }
+
+        //Decodes count code units of charSize (1 = already UTF-8/ANSI, 2 = UTF-16, 4 = UTF-32)
+        static void Append(const unsigned char* data, size_t count, int charSize, std::string & out)
+        {
+            if (charSize == 2)
+                AppendUtf16(data, count, out);
+            else if (charSize == 4)
+                AppendUtf32(data, count, out);
+            else
+                out.append((const char*)data, count);
+        }
+
+        static void Append(std::string & out, unsigned int cp)
+        {
+            if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+                cp = 0xFFFD;
+            if (cp < 0x80)
+                out.push_back(char(cp));
+            else if (cp < 0x800)
+            {
+                out.push_back(char(0xC0 | (cp >> 6)));
+                out.push_back(char(0x80 | (cp & 0x3F)));
+            }
+            else if (cp < 0x10000)
+            {
+                out.push_back(char(0xE0 | (cp >> 12)));
+                out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back(char(0x80 | (cp & 0x3F)));
+            }
+            else
+            {
+                out.push_back(char(0xF0 | (cp >> 18)));
+                out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+                out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back(char(0x80 | (cp & 0x3F)));
+            }
+        }
+
+    private:
+        static unsigned int unit16(const unsigned char* data, size_t index)
+        {
+            return data[index * 2] | (unsigned int)data[index * 2 + 1] << 8;
+        }
+    };
+};
\ No newline at end of file
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "Types.h"
+#include "Dump.h"
+
+namespace Types
+{
+    struct Symbol
+    {
+        std::string name; //Symbol identifier
+        unsigned long long start = 0; //First address
+        unsigned long long size = 0; //Size in bytes, 0 if unknown (only the start address matches)
+    };
+
+    //Sorted address -> symbol index over functions and ELF symbol tables.
+    //Add symbols, Build once, then look addresses up (lookups are const and need no locking).
+    struct SymbolIndex
+    {
+        void Clear()
+        {
+            mSymbols.clear();
+            mStarts.clear();
+        }
+
+        void Add(const std::string & name, unsigned long long start, unsigned long long size = 0)
+        {
+            Symbol s;
+            s.name = name;
+            s.start = start;
+            s.size = size;
+            mSymbols.push_back(s);
+        }
+
+        //Functions with a known address (Function::address and Function::size)
+        void AddFunctions(const TypeManager & t)
+        {
+            for (const auto & f : t.Functions())
+                if (f.second.address)
+                    Add(f.first, f.second.address, f.second.size);
+        }
+
+        //STT_FUNC and STT_OBJECT entries of .symtab and .dynsym (little endian, 32 or 64 bit), bias is added to
+        //their values (the load address of a shared object)
+        bool AddElf(const std::string & path, unsigned long long bias = 0)
+        {
+            MappedFile file;
+            if (!file.Open(path))
+                return false;
+            auto ident = file.At(0, 16);
+            if (!ident || memcmp(ident, "\x7F" "ELF", 4) != 0 || ident[5] != 1) //ELFDATA2LSB
+                return false;
+            auto is64 = ident[4] == 2; //ELFCLASS64
+            if (!is64 && ident[4] != 1)
+                return false;
+            unsigned long long shoff = is64 ? read<unsigned long long>(file, 40) : read<unsigned int>(file, 32);
+            size_t shentsize = read<unsigned short>(file, is64 ? 58 : 46);
+            size_t shnum = read<unsigned short>(file, is64 ? 60 : 48);
+            if (shentsize < (is64 ? 64u : 40u) || !file.At(shoff, shentsize * shnum))
+                return false;
+
+            auto count = mSymbols.size();
+            for (size_t i = 0; i < shnum; i++)
+            {
+                auto sh = shoff + i * shentsize;
+                auto type = read<unsigned int>(file, sh + 4);
+                if (type != 2 && type != 11) //SHT_SYMTAB, SHT_DYNSYM
+                    continue;
+                auto offset = is64 ? read<unsigned long long>(file, sh + 24) : read<unsigned int>(file, sh + 16);
+                auto size = is64 ? read<unsigned long long>(file, sh + 32) : read<unsigned int>(file, sh + 20);
+                auto link = read<unsigned int>(file, sh + (is64 ? 40 : 24));
+                auto entsize = is64 ? read<unsigned long long>(file, sh + 56) : read<unsigned int>(file, sh + 36);
+                if (link >= shnum || entsize < (is64 ? 24u : 16u))
+                    continue;
+                auto strsh = shoff + link * shentsize;
+                auto stroff = is64 ? read<unsigned long long>(file, strsh + 24) : read<unsigned int>(file, strsh + 16);
+                auto strsize = is64 ? read<unsigned long long>(file, strsh + 32) : read<unsigned int>(file, strsh + 20);
+                auto strtab = (const char*)file.At(stroff, size_t(strsize));
+                if (!strtab || !file.At(offset, size_t(size)))
+                    continue;
+                for (unsigned long long sym = offset; sym + entsize <= offset + size; sym += entsize)
+                {
+                    unsigned int name = read<unsigned int>(file, sym);
+                    unsigned char info = read<unsigned char>(file, sym + (is64 ? 4 : 12));
+                    unsigned short shndx = read<unsigned short>(file, sym + (is64 ? 6 : 14));
+                    auto value = is64 ? read<unsigned long long>(file, sym + 8) : read<unsigned int>(file, sym + 4);
+                    auto symsize = is64 ? read<unsigned long long>(file, sym + 16) : read<unsigned int>(file, sym + 8);
+                    auto kind = info & 0xF;
+                    if ((kind != 2 && kind != 1) || !shndx || !name || name >= strsize) //STT_FUNC, STT_OBJECT, SHN_UNDEF
+                        continue;
+                    auto length = strnlen(strtab + name, size_t(strsize - name));
+                    Add(std::string(strtab + name, length), value + bias, symsize);
+                }
+            }
+            return mSymbols.size() > count;
+        }
+
+        //Sorts the symbols, at the same start the largest one wins
+        void Build()
+        {
+            std::stable_sort(mSymbols.begin(), mSymbols.end(), [](const Symbol & a, const Symbol & b)
+            {
+                return a.start < b.start || (a.start == b.start && a.size > b.size);
+            });
+            mSymbols.erase(std::unique(mSymbols.begin(), mSymbols.end(), [](const Symbol & a, const Symbol & b)
+            {
+                return a.start == b.start;
+            }), mSymbols.end());
+            mStarts.resize(mSymbols.size());
+            for (size_t i = 0; i < mSymbols.size(); i++)
+                mStarts[i] = mSymbols[i].start;
+        }
+
+        size_t Count() const
+        {
+            return mSymbols.size();
+        }
+
+        //Symbol containing address, nullptr if there is none
+        const Symbol* Find(unsigned long long address) const
+        {
+            auto i = std::upper_bound(mStarts.begin(), mStarts.end(), address) - mStarts.begin();
+            return contains(size_t(i), address) ? &mSymbols[size_t(i) - 1] : nullptr;
+        }
+
+        //Looks up count addresses at once (results[i] is nullptr if there is no symbol). Ascending runs of
+        //addresses (sorted vtables, callback tables) continue from the previous hit instead of searching again.
+        void Find(const unsigned long long* addresses, size_t count, const Symbol** results) const
+        {
+            size_t i = 0; //upper bound of the previous address
+            unsigned long long previous = 0;
+            for (size_t n = 0; n < count; n++)
+            {
+                auto address = addresses[n];
+                if (address < previous || !n)
+                    i = size_t(std::upper_bound(mStarts.begin(), mStarts.end(), address) - mStarts.begin());
+                else
+                {
+                    //gallop forward from the previous position
+                    size_t step = 1;
+                    auto last = i;
+                    while (last < mStarts.size() && mStarts[last] <= address)
+                    {
+                        i = last + 1;
+                        last += step;
+                        step *= 2;
+                    }
+                    auto end = last < mStarts.size() ? mStarts.begin() + last : mStarts.end();
+                    i = size_t(std::upper_bound(mStarts.begin() + i, end, address) - mStarts.begin());
+                }
+                results[n] = contains(i, address) ? &mSymbols[i - 1] : nullptr;
+                previous = address;
+            }
+        }
+
+        //Registers the primary vtable of every type with a _ZTV symbol (plain or namespaced names), returns how many
+        int AddVtables(TypeManager & t, int pointerSize = int(sizeof(void*))) const
+        {
+            auto count = 0;
+            std::string name;
+            for (const auto & s : mSymbols)
+                if (!s.name.compare(0, 4, "_ZTV") && demangle(s.name.c_str() + 4, name) && t.AddVtable(name, s.start + 2 * pointerSize))
+                    count++;
+            return count;
+        }
+
+        //Appends symbol or symbol+0xoff, returns false if address is not inside a symbol
+        bool Format(unsigned long long address, std::string & out) const
+        {
+            auto s = Find(address);
+            if (!s)
+                return false;
+            out += s->name;
+            if (address != s->start)
+            {
+                char offset[32] = "";
+                sprintf_s(offset, "+0x%llX", address - s->start);
+                out += offset;
+            }
+            return true;
+        }
+
+    private:
+        std::vector<Symbol> mSymbols; //Sorted by start
+        std::vector<unsigned long long> mStarts; //Symbol starts (searched without touching the names)
+
+        //Does the symbol before upper bound i contain address?
+        bool contains(size_t i, unsigned long long address) const
+        {
+            if (!i)
+                return false;
+            const auto & s = mSymbols[i - 1];
+            return address == s.start || address - s.start < s.size;
+        }
+
+        //<length><name> or N<length><name>...E as ns::name
+        static bool demangle(const char* mangled, std::string & name)
+        {
+            name.clear();
+            auto nested = *mangled == 'N';
+            if (nested)
+                mangled++;
+            do
+            {
+                char* end = nullptr;
+                auto length = strtoul(mangled, &end, 10);
+                if (end == mangled || !length || strnlen(end, length) < length)
+                    return false;
+                if (!name.empty())
+                    name += "::";
+                name.append(end, length);
+                mangled = end + length;
+            } while (nested && *mangled != 'E');
+            return nested ? mangled[1] == '\0' : *mangled == '\0';
+        }
+
+        template<typename T>
+        static T read(const MappedFile & file, unsigned long long offset)
+        {
+            T value = T();
+            auto data = file.At(offset, sizeof(T));
+            if (data)
+                memcpy(&value, data, sizeof(T));
+            return value;
+        }
+    };
+};
\ No newline at end of file
@@ -1,133 +1,9 @@
-#include "Types.h"
+#include "Visitors.h"
+#include "Columnar.h"
+#include "Cursor.h"
 
 using namespace Types;
 
-struct PrintVisitor : TypeManager::Visitor
-{
-    explicit PrintVisitor(void* data = nullptr, int maxPtrDepth = 0)
-        : mData(data), mMaxPtrDepth(maxPtrDepth) { }
-
-    bool visitType(const Member & member, const Type & type) override
-    {
-        unsigned long long value = 0;
-        if (mData)
-            memcpy(&value, (char*)mData + mOffset, size_t(type.size));
-        char valueStr[256] = "";
-        switch (type.primitive)
-        {
-        case Pointer:
-            sprintf_s(valueStr, "0x%p", value);
-            break;
-        case String:
-            sprintf_s(valueStr, "\"%s\"", (char*)value);
-            break;
-        case WString:
-            sprintf_s(valueStr, "L\"%S\"", (wchar_t*)value);
-            break;
-        default:
-            sprintf_s(valueStr, "0x%llX", value);
-            break;
-        }
-        indent();
-        if (parent().type == Parent::Array)
-            printf("%s %s[%d] = %s;", type.name.c_str(), member.name.c_str(), parent().index++, valueStr);
-        else
-            printf("%s %s = %s;", type.name.c_str(), member.name.c_str(), valueStr);
-        puts(type.pointto.empty() || mPtrDepth >= mMaxPtrDepth ? "" : " {");
-        if (parent().type != Parent::Union)
-            mOffset += type.size;
-        return true;
-    }
-
-    bool visitStructUnion(const Member & member, const StructUnion & type) override
-    {
-        indent();
-        printf("%s %s {\n", type.isunion ? "union" : "struct", type.name.c_str());
-        mParents.push_back(Parent(type.isunion ? Parent::Union : Parent::Struct));
-        return true;
-    }
-
-    bool visitArray(const Member & member) override
-    {
-        indent();
-        printf("%s[%d] {\n", member.type.c_str(), member.arrsize);
-        mParents.push_back(Parent(Parent::Array));
-        return true;
-    }
-
-    bool visitPtr(const Member & member, const Type & type) override
-    {
-        auto offset = mOffset;
-        auto res = visitType(member, type); //print the pointer value
-        if (mPtrDepth >= mMaxPtrDepth)
-            return false;
-        void* value = nullptr;
-        if (mData)
-            memcpy(&value, (char*)mData + offset, size_t(type.size));
-        else
-            return false;
-        mParents.push_back(Parent(Parent::Pointer));
-        parent().offset = mOffset;
-        parent().data = mData;
-        mOffset = 0;
-        mData = value;
-        mPtrDepth++;
-        return res;
-    }
-
-    bool visitBack(const Member & member) override
-    {
-        if (parent().type == Parent::Pointer)
-        {
-            mOffset = parent().offset;
-            mData = parent().data;
-            mPtrDepth--;
-        }
-        mParents.pop_back();
-        indent();
-        printf("} %s;\n", member.name.c_str());
-        return true;
-    }
-
-private:
-    struct Parent
-    {
-        enum Type
-        {
-            Struct,
-            Union,
-            Array,
-            Pointer
-        };
-        
-        Type type;
-        int index = 0;
-        void* data = nullptr;
-        int offset = 0;
-
-        explicit Parent(Type type)
-            : type(type) { }
-    };
-
-    Parent & parent()
-    {
-        return mParents[mParents.size() - 1];
-    }
-
-    void indent() const
-    {
-        printf("%p:%02d: ", mData, mOffset);
-        for (auto i = 0; i < int(mParents.size()) * 2; i++)
-            printf(" ");
-    }
-
-    std::vector<Parent> mParents;
-    int mOffset = 0;
-    void* mData = nullptr;
-    int mPtrDepth = 0;
-    int mMaxPtrDepth = 0;
-};
-
 #pragma pack(push, 1)
 int main()
 {
@@ -210,6 +86,24 @@ int main()
 
     printf("t.Visit(t, TEST) = %d\n", t.Visit("t", "TEST", visitor = PrintVisitor(&test)));
 
+    char json[512];
+    JsonVisitor jsonVisitor(json, sizeof(json), &test);
+    printf("t.Visit(t, TEST) = %d\n", t.Visit("t", "TEST", jsonVisitor));
+    puts(json);
+
+    TEST tests[3];
+    tests[1].a = 0xA1;
+    tests[2].a = 0xA2;
+    std::vector<Column> columns;
+    printf("ColumnExporter::Export(tests, TEST) = %d\n", ColumnExporter::Export(t, "TEST", tests, 3, columns));
+    for (const auto & column : columns)
+        printf("%s %s (%d bytes)\n", column.type.c_str(), column.path.c_str(), int(column.data.size()));
+    printf("a = { 0x%X, 0x%X, 0x%X }\n", columns[0].As<int>()[0], columns[0].As<int>()[1], columns[0].As<int>()[2]);
+
+    LayoutCursor cursor(t, "TEST");
+    for (auto found = cursor.Seek(8); found; found = cursor.Next())
+        printf("%s %s @ %d (depth %d)\n", cursor.Leaf()->name.c_str(), cursor.Path().c_str(), cursor.Offset(), cursor.Depth());
+
     puts("- - - -");
 
     struct POINTEE
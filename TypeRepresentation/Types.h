@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -25,6 +29,125 @@ namespace Types
         WString //wchar_t* (null-terminated)
     };
 
+    //Named values of an enum or flags type. Dense enums are looked up in a direct table, sparse ones
+    //by binary search, and flags are decomposed one set bit at a time.
+    struct Enum
+    {
+        std::string owner; //Enum owner
+        std::string name; //Enum identifier (also registered as a Type)
+        int size = 0; //Size of the underlying integer in bytes
+        bool isflags = false; //Values are combined bit flags
+        std::vector<unsigned long long> values; //Sorted values (truncated to size)
+        std::vector<std::string> names; //names[i] is the name of values[i]
+
+        Enum()
+        {
+            for (auto & b : bits)
+                b = -1;
+        }
+
+        //Name of exactly value, nullptr if there is none
+        const std::string* Find(unsigned long long value) const
+        {
+            if (!dense.empty())
+            {
+                auto index = value - base;
+                return index < dense.size() && dense[size_t(index)] >= 0 ? &names[size_t(dense[size_t(index)])] : nullptr;
+            }
+            auto found = std::lower_bound(values.begin(), values.end(), value);
+            return found != values.end() && *found == value ? &names[found - values.begin()] : nullptr;
+        }
+
+        //Appends the name of value, for flags without an exact name the names of its bits joined with |
+        //(bits without a name as one hex number). Returns false if no name matched at all.
+        bool Format(unsigned long long value, std::string & out) const
+        {
+            auto exact = Find(value);
+            if (exact)
+            {
+                out += *exact;
+                return true;
+            }
+            if (!isflags || !value)
+                return false;
+            auto named = false;
+            unsigned long long rest = 0;
+            for (auto remaining = value; remaining; )
+            {
+                auto bit = remaining & (~remaining + 1);
+                remaining ^= bit;
+                auto index = bits[bitIndex(bit)];
+                if (index < 0)
+                {
+                    rest |= bit;
+                    continue;
+                }
+                if (named)
+                    out.push_back('|');
+                out += names[size_t(index)];
+                named = true;
+            }
+            if (named && rest)
+            {
+                char hex[32] = "";
+                sprintf_s(hex, "|0x%llX", rest);
+                out += hex;
+            }
+            return named;
+        }
+
+        //Adds or renames a value and rebuilds the lookup tables
+        void Add(unsigned long long value, const std::string & valueName)
+        {
+            if (size < 8)
+                value &= (1ULL << (size * 8)) - 1;
+            auto found = std::lower_bound(values.begin(), values.end(), value);
+            auto i = found - values.begin();
+            if (found != values.end() && *found == value)
+                names[i] = valueName;
+            else
+            {
+                values.insert(found, value);
+                names.insert(names.begin() + i, valueName);
+            }
+            index();
+        }
+
+        unsigned long long base = 0; //values[0] if the direct table is used
+        std::vector<int> dense; //value - base -> index in names (-1 if unnamed), empty for sparse enums
+        int bits[64]; //bit number -> index of the single-bit flag, -1 if unnamed
+
+    private:
+        void index()
+        {
+            dense.clear();
+            base = values.empty() ? 0 : values.front();
+            if (!values.empty() && values.back() - base < 4 * values.size() + 64)
+            {
+                dense.assign(size_t(values.back() - base + 1), -1);
+                for (size_t i = 0; i < values.size(); i++)
+                    dense[size_t(values[i] - base)] = int(i);
+            }
+            for (auto & b : bits)
+                b = -1;
+            for (size_t i = 0; i < values.size(); i++)
+                if (values[i] && !(values[i] & (values[i] - 1)))
+                    bits[bitIndex(values[i])] = int(i);
+        }
+
+        static int bitIndex(unsigned long long bit)
+        {
+            static const int debruijn[64] =
+            {
+                0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+                62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+                63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+                46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+            };
+            return debruijn[(bit * 0x03F79D71B4CB0A89ULL) >> 58];
+        }
+    };
+
     struct Type
     {
         std::string owner; //Type owner
@@ -32,6 +155,7 @@ namespace Types
         std::string pointto; //Type identifier of *Type
         Primitive primitive; //Primitive type.
         int size = 0; //Size in bytes.
+        const Enum* enumeration = nullptr; //Named values if Type is an enum or flags type
     };
 
     struct Member
@@ -39,6 +163,39 @@ namespace Types
         std::string name; //Member identifier
         std::string type; //Type.name
         int arrsize = 0; //Number of elements if Member is an array
+        int offset = 0; //Offset in bytes from the start of the parent
+        int bitoffset = 0; //First bit of a bitfield in the storage unit at offset
+        int bitsize = 0; //Width of a bitfield, 0 if Member is not a bitfield
+        bool isbase = false; //Base class subobject (named after its type)
+    };
+
+    //Most-derived type of the objects whose vptr holds a vtable address point (Itanium C++ ABI)
+    struct Vtable
+    {
+        std::string owner; //Owner of the type
+        std::string type; //Most-derived StructUnion
+        int offset = 0; //Offset of the subobject holding this vptr in type (0 for the primary vtable)
+    };
+
+    //Selects the active member of a union member from a sibling tag field of the enclosing struct
+    struct Discriminator
+    {
+        std::string tag; //Sibling member holding the tag
+        int offset = 0; //Offset of the tag relative to the union member
+        int size = 0; //Size of the tag in bytes
+        bool isSigned = false; //Tag values are sign extended
+        std::unordered_map<long long, int> cases; //Tag value -> index of the active union member
+        int fallback = -1; //Union member index for other values, -1 to visit all members
+    };
+
+    //Takes the element count of an array or typed pointer member from an integer sibling at visit time
+    struct ElementCount
+    {
+        std::string field; //Sibling member holding the count
+        int offset = 0; //Offset of the count in the struct
+        int size = 0; //Size of the count in bytes
+        bool isSigned = false; //Negative counts mean no elements
+        int maxcount = 0; //Upper bound for counts read from the target
     };
 
     struct StructUnion
@@ -47,7 +204,36 @@ namespace Types
         std::string name; //StructUnion identifier
         std::vector<Member> members; //StructUnion members
         bool isunion = false; //Is this a union?
+        bool polymorphic = false; //Pointers to it are resolved to the most-derived type through the vptr at offset 0
         int size = 0;
+        std::unordered_map<std::string, Discriminator> discriminators; //Union member -> its tag
+        std::unordered_map<std::string, ElementCount> counts; //Counted member -> where its element count is
+    };
+
+    struct Field
+    {
+        std::string path; //Member path from the root (e.g. e.d[0])
+        std::string type; //Type.name
+        Primitive primitive; //Primitive type.
+        int offset = 0; //Offset in bytes from the start of the root
+        int size = 0; //Size in bytes.
+        int bitoffset = 0; //First bit of a bitfield in the storage unit at offset
+        int bitsize = 0; //Width of a bitfield, 0 if the field is not a bitfield
+    };
+
+    struct Layout
+    {
+        std::string type; //Root type identifier
+        int size = 0; //Size of the root in bytes
+        std::vector<Field> fields; //Flattened leaf fields in visit order
+
+        const Field* FindField(const std::string & path) const
+        {
+            for (const auto & f : fields)
+                if (f.path == path)
+                    return &f;
+            return nullptr;
+        }
     };
 
     enum CallingConvention
@@ -55,7 +241,9 @@ namespace Types
         Cdecl,
         Stdcall,
         Thiscall,
-        Delphi
+        Delphi,
+        SysV64, //System V AMD64 ABI (Linux, macOS)
+        Win64 //Microsoft x64
     };
 
     struct Function
@@ -65,9 +253,117 @@ namespace Types
         std::string rettype; //Function return type
         CallingConvention callconv; //Function calling convention
         bool noreturn; //Function does not return (ExitProcess, _exit)
+        unsigned long long address = 0; //Entry point (0 if unknown)
+        unsigned long long size = 0; //Code size in bytes (0 if unknown)
         std::vector<Member> args; //Function arguments
     };
 
+    //What the visit engine does after visitStructUnion/visitArray
+    enum VisitAction
+    {
+        Abort, //Stop the visit
+        Continue, //Visit the members/elements
+        Skip //Leave out the members/elements (and the visitBack)
+    };
+
+    //Member paths a visit is restricted to. Paths are relative to the root without array indices (e.g. e.d),
+    //a pointee continues the path of its pointer (p.n) and a * component matches any member.
+    struct VisitFilter
+    {
+        //Visits only these subtrees (and the members leading to them), everything if none is included
+        void Include(const std::string & path)
+        {
+            mInclude.push_back(split(path));
+        }
+
+        //Never visits these subtrees
+        void Exclude(const std::string & path)
+        {
+            mExclude.push_back(split(path));
+        }
+
+        //A leaf (not a struct/union/typed pointer) leads nowhere, so it has to be inside an included subtree
+        bool Accept(const std::vector<const std::string*> & path, bool leaf = false) const
+        {
+            for (const auto & pattern : mExclude)
+                if (pattern.size() <= path.size() && matches(pattern, path, pattern.size()))
+                    return false;
+            if (mInclude.empty())
+                return true;
+            for (const auto & pattern : mInclude)
+            {
+                if (pattern.size() <= path.size())
+                {
+                    if (matches(pattern, path, pattern.size()))
+                        return true;
+                }
+                else if (!leaf && matches(pattern, path, path.size()))
+                    return true;
+            }
+            return false;
+        }
+
+    private:
+        std::vector<std::vector<std::string>> mInclude;
+        std::vector<std::vector<std::string>> mExclude;
+
+        static std::vector<std::string> split(const std::string & path)
+        {
+            std::vector<std::string> components(1);
+            for (auto ch : path)
+            {
+                if (ch == '.')
+                    components.push_back(std::string());
+                else
+                    components.back().push_back(ch);
+            }
+            return components;
+        }
+
+        static bool matches(const std::vector<std::string> & pattern, const std::vector<const std::string*> & path, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                if (pattern[i] != "*" && pattern[i] != *path[i])
+                    return false;
+            return true;
+        }
+    };
+
+    //Set from any thread to stop visits that check it (VisitBudget::cancel)
+    struct CancelToken
+    {
+        CancelToken()
+        {
+            mCancelled = false;
+        }
+
+        void Cancel() { mCancelled = true; }
+        void Reset() { mCancelled = false; }
+        bool Cancelled() const { return mCancelled; }
+
+    private:
+        std::atomic<bool> mCancelled;
+    };
+
+    //Limits for one TypeManager::Resume call. When one is reached the visit is Suspended and the next
+    //Resume continues where it stopped (every call makes progress on at least one member).
+    struct VisitBudget
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        size_t nodes = 0; //Members visited, 0 for no limit
+        size_t bytes = 0; //Bytes of values and pointers visited, 0 for no limit
+        Clock::time_point deadline = Clock::time_point::max();
+        const CancelToken* cancel = nullptr; //Cancels the visit (it fails with Cancelled)
+
+        static VisitBudget For(std::chrono::microseconds duration)
+        {
+            VisitBudget budget;
+            budget.deadline = Clock::now() + duration;
+            return budget;
+        }
+    };
+
     struct TypeManager
     {
         explicit TypeManager()
@@ -75,6 +371,32 @@ namespace Types
             setupPrimitives();
         }
 
+        //Copies relink Type::enumeration to their own enums
+        TypeManager(const TypeManager & other)
+        {
+            *this = other;
+        }
+
+        TypeManager & operator=(const TypeManager & other)
+        {
+            if (this == &other)
+                return *this;
+            primitivesizes = other.primitivesizes;
+            types = other.types;
+            structs = other.structs;
+            functions = other.functions;
+            layouts = other.layouts;
+            enums = other.enums;
+            vtables = other.vtables;
+            laststruct = other.laststruct;
+            lastfunction = other.lastfunction;
+            lastenum = other.lastenum;
+            for (auto & t : types)
+                if (t.second.enumeration)
+                    t.second.enumeration = &enums.find(t.first)->second;
+            return *this;
+        }
+
         bool AddType(const std::string & owner, const std::string & name, const std::string & type)
         {
             auto found = types.find(type);
@@ -96,6 +418,47 @@ namespace Types
             return addType(t);
         }
 
+        //Enum (or flags) type over an integer type, it can be used wherever the integer type can
+        bool AddEnum(const std::string & owner, const std::string & name, const std::string & type = "int", bool isflags = false)
+        {
+            auto found = types.find(type);
+            if (found == types.end() || !isInteger(found->second.primitive) || !AddType(owner, name, found->second.primitive))
+                return false;
+            lastenum = name;
+            Enum e;
+            e.owner = owner;
+            e.name = name;
+            e.size = found->second.size;
+            e.isflags = isflags;
+            types[name].enumeration = &enums.insert({ name, e }).first->second; //map nodes do not move
+            return true;
+        }
+
+        bool AddFlags(const std::string & owner, const std::string & name, const std::string & type = "unsigned int")
+        {
+            return AddEnum(owner, name, type, true);
+        }
+
+        bool AddEnumValue(const std::string & type, const std::string & name, long long value)
+        {
+            auto found = enums.find(type);
+            if (found == enums.end() || name.empty())
+                return false;
+            found->second.Add((unsigned long long)value, name);
+            return true;
+        }
+
+        bool AppendEnumValue(const std::string & name, long long value)
+        {
+            return AddEnumValue(lastenum, name, value);
+        }
+
+        const Enum* FindEnum(const std::string & name) const
+        {
+            auto found = enums.find(name);
+            return found == enums.end() ? nullptr : &found->second;
+        }
+
         bool AddStruct(const std::string & owner, const std::string & name)
         {
             StructUnion s;
@@ -118,6 +481,56 @@ namespace Types
             return AddMember(laststruct, name, type, arrsize, offset);
         }
 
+        bool AppendBitfield(const std::string & name, const std::string & type, int bits, int bitOffset = -1)
+        {
+            return AddBitfield(laststruct, name, type, bits, bitOffset);
+        }
+
+        //Integer bitfield of bits width. Like MSVC it continues the storage unit of the previous bitfield if that
+        //has the same size and room left, otherwise it starts a new unit. bitOffset places it in the unit explicitly
+        //(register descriptions), it cannot go back before the bits already used.
+        bool AddBitfield(const std::string & parent, const std::string & name, const std::string & type, int bits, int bitOffset = -1)
+        {
+            auto found = structs.find(parent);
+            auto foundT = types.find(type);
+            if (found == structs.end() || foundT == types.end() || !isInteger(foundT->second.primitive) || name.empty())
+                return false;
+            auto & s = found->second;
+            auto unit = foundT->second.size;
+            if (bits <= 0 || bits > unit * 8 || bitOffset + bits > unit * 8 || findMember(s, name))
+                return false;
+
+            Member m;
+            m.name = name;
+            m.type = type;
+            m.bitsize = bits;
+            const Member* last = s.isunion || s.members.empty() ? nullptr : &s.members.back();
+            if (last && last->bitsize && Sizeof(last->type) == unit)
+            {
+                auto next = last->bitoffset + last->bitsize;
+                auto position = bitOffset >= 0 ? bitOffset : next;
+                if (position < next)
+                    return false;
+                if (position + bits <= unit * 8)
+                {
+                    m.offset = last->offset;
+                    m.bitoffset = position;
+                    s.members.push_back(m);
+                    layouts.clear();
+                    return true;
+                }
+            }
+            m.offset = s.isunion ? 0 : s.size;
+            m.bitoffset = bitOffset >= 0 ? bitOffset : 0;
+            s.members.push_back(m);
+            layouts.clear();
+            if (!s.isunion)
+                s.size += unit;
+            else if (unit > s.size)
+                s.size = unit;
+            return true;
+        }
+
         bool AddMember(const std::string & parent, const std::string & name, const std::string & type, int arrsize = 0, int offset = -1)
         {
             if (!isDefined(type) && !validPtr(type))
@@ -139,6 +552,7 @@ namespace Types
             m.name = name;
             m.arrsize = arrsize;
             m.type = type;
+            m.offset = s.isunion ? 0 : s.size;
 
             if (offset >= 0) //user-defined offset
             {
@@ -149,15 +563,18 @@ namespace Types
                     Member pad;
                     pad.type = "char";
                     pad.arrsize = offset - s.size;
+                    pad.offset = s.size;
                     char padname[32] = "";
                     sprintf_s(padname, "padding%d", pad.arrsize);
                     pad.name = padname;
-                    s.members.push_back(m);
+                    s.members.push_back(pad);
                     s.size += pad.arrsize;
+                    m.offset = s.size;
                 }
             }
 
             s.members.push_back(m);
+            layouts.clear();
 
             if (s.isunion)
             {
@@ -171,6 +588,127 @@ namespace Types
             return true;
         }
 
+        //Base class subobject of type (C++ inheritance), visited like a member named after the base
+        bool AddBase(const std::string & type, const std::string & base, int offset = -1)
+        {
+            if (!structs.count(base) || !AddMember(type, base, base, 0, offset))
+                return false;
+            structs[type].members.back().isbase = true;
+            return true;
+        }
+
+        bool AppendBase(const std::string & base)
+        {
+            return AddBase(laststruct, base);
+        }
+
+        //Objects whose vptr holds address (a vtable address point: the _ZTV symbol + 2 pointers) are of type. offset
+        //is where the subobject with that vptr lives in type (secondary vtables of multiple inheritance). Pointers to
+        //type and to its bases are then visited as the most-derived type.
+        bool AddVtable(const std::string & type, unsigned long long address, int offset = 0)
+        {
+            auto found = structs.find(type);
+            if (found == structs.end() || found->second.isunion || !address || offset < 0 || offset >= found->second.size)
+                return false;
+            Vtable v;
+            v.owner = found->second.owner;
+            v.type = type;
+            v.offset = offset;
+            vtables[address] = v;
+            markPolymorphic(found->second);
+            return true;
+        }
+
+        const Vtable* FindVtable(unsigned long long address) const
+        {
+            auto found = vtables.find(address);
+            return found == vtables.end() ? nullptr : &found->second;
+        }
+
+        const std::unordered_map<unsigned long long, Vtable> & Vtables() const
+        {
+            return vtables;
+        }
+
+        //Visits of the union member of type only enter the union member selected by the value of the
+        //integer sibling tag (or fallback for values without a case, all members without a fallback)
+        bool AddDiscriminator(const std::string & type, const std::string & member, const std::string & tag, const std::string & fallback = "")
+        {
+            auto found = structs.find(type);
+            if (found == structs.end() || found->second.isunion)
+                return false;
+            auto & s = found->second;
+            auto u = findMember(s, member);
+            auto t = findMember(s, tag);
+            if (!u || !t || u->arrsize || t->arrsize || t->bitsize)
+                return false;
+            auto foundU = structs.find(u->type);
+            auto foundT = types.find(t->type);
+            if (foundU == structs.end() || !foundU->second.isunion || foundT == types.end() || !isInteger(foundT->second.primitive))
+                return false;
+            Discriminator d;
+            d.tag = tag;
+            d.offset = t->offset - u->offset;
+            d.size = foundT->second.size;
+            d.isSigned = isSignedInteger(foundT->second.primitive);
+            if (!fallback.empty())
+            {
+                d.fallback = memberIndex(foundU->second, fallback);
+                if (d.fallback < 0)
+                    return false;
+            }
+            s.discriminators[member] = d;
+            return true;
+        }
+
+        //Tag value of a discriminated union member that selects the union member active
+        bool AddCase(const std::string & type, const std::string & member, long long value, const std::string & active)
+        {
+            auto found = structs.find(type);
+            if (found == structs.end())
+                return false;
+            auto d = found->second.discriminators.find(member);
+            if (d == found->second.discriminators.end())
+                return false;
+            auto u = structs.find(findMember(found->second, member)->type);
+            auto index = u == structs.end() ? -1 : memberIndex(u->second, active);
+            if (index < 0)
+                return false;
+            d->second.cases[value] = index;
+            return true;
+        }
+
+        //Visits of the member of type get their element count from the integer sibling count: an array member
+        //visits count elements (which may run past its declared size, as in { int n; ITEM items[1]; }) and a typed
+        //pointer member visits its pointee as an array of count elements. Counts are clamped to maxCount, which
+        //defaults to DefaultMaxCount (not the declared array size, which is often a placeholder like items[1]).
+        bool AddCount(const std::string & type, const std::string & member, const std::string & count, int maxCount = 0)
+        {
+            auto found = structs.find(type);
+            if (found == structs.end() || found->second.isunion || member == count)
+                return false;
+            auto & s = found->second;
+            auto m = findMember(s, member);
+            auto c = findMember(s, count);
+            if (!m || !c || c->arrsize || c->bitsize)
+                return false;
+            auto foundM = types.find(m->type);
+            auto foundC = types.find(c->type);
+            auto pointer = !m->arrsize && foundM != types.end() && !foundM->second.pointto.empty();
+            if ((!m->arrsize && !pointer) || foundC == types.end() || !isInteger(foundC->second.primitive))
+                return false;
+            ElementCount e;
+            e.field = count;
+            e.offset = c->offset;
+            e.size = foundC->second.size;
+            e.isSigned = isSignedInteger(foundC->second.primitive);
+            e.maxcount = maxCount > 0 ? maxCount : int(DefaultMaxCount);
+            s.counts[member] = e;
+            return true;
+        }
+
+        static const int DefaultMaxCount = 0x10000;
+
         bool AddFunction(const std::string & owner, const std::string & name, const std::string & rettype, CallingConvention callconv = Cdecl, bool noreturn = false)
         {
             auto found = functions.find(name);
@@ -218,31 +756,373 @@ namespace Types
             return 0;
         }
 
+        const Type* FindType(const std::string & name) const
+        {
+            auto found = types.find(name);
+            return found == types.end() ? nullptr : &found->second;
+        }
+
+        const StructUnion* FindStruct(const std::string & name) const
+        {
+            auto found = structs.find(name);
+            return found == structs.end() ? nullptr : &found->second;
+        }
+
+        const Function* FindFunction(const std::string & name) const
+        {
+            auto found = functions.find(name);
+            return found == functions.end() ? nullptr : &found->second;
+        }
+
+        const std::unordered_map<std::string, Function> & Functions() const
+        {
+            return functions;
+        }
+
+        bool SetFunctionAddress(const std::string & name, unsigned long long address, unsigned long long size = 0)
+        {
+            auto found = functions.find(name);
+            if (found == functions.end())
+                return false;
+            found->second.address = address;
+            found->second.size = size;
+            return true;
+        }
+
+        //Flattened leaf fields of a type with their absolute offsets (cached until the type system changes).
+        const Layout* GetLayout(const std::string & type)
+        {
+            auto found = layouts.find(type);
+            if (found != layouts.end())
+                return &found->second;
+            if (!isDefined(type))
+                return nullptr;
+            Layout layout;
+            layout.type = type;
+            layout.size = Sizeof(type);
+            flatten(type, "", 0, layout.fields);
+            return &layouts.insert({ type, layout }).first->second;
+        }
+
         struct Visitor
         {
             virtual ~Visitor() { }
             virtual bool visitType(const Member & member, const Type & type) = 0;
-            virtual bool visitStructUnion(const Member & member, const StructUnion & type) = 0;
-            virtual bool visitArray(const Member & member) = 0;
-            virtual bool visitPtr(const Member & member, const Type & type) = 0;
+            virtual VisitAction visitStructUnion(const Member & member, const StructUnion & type) = 0;
+            virtual VisitAction visitArray(const Member & member) = 0;
+            virtual bool visitPtr(const Member & member, const Type & type, int pointeeSize) = 0; //pointeeSize is Sizeof(type.pointto)
             virtual bool visitBack(const Member & member) = 0;
+
+            //Asked by AsyncVisit before visitType/visitPtr (type set) or visitStructUnion (type null) of a member
+            //of size bytes (pointers: pointeeSize bytes at the target), return false to suspend the visit until
+            //the data the visitor needs is available
+            virtual bool ready(const Member & member, const Type* type, int size, int pointeeSize)
+            {
+                return true;
+            }
+
+            //Reads size bytes at offset from the start of the struct/union just entered (negative offsets reach
+            //siblings) or the pointee just followed, false if the visitor has no data. Used to select the active
+            //member of tagged unions and to read vptrs.
+            virtual bool peek(int offset, int size, unsigned long long & value)
+            {
+                return false;
+            }
         };
 
-        bool Visit(const std::string & name, const std::string & type, Visitor & visitor)
+        //Index of the member of the union member of outer that its tag selects, -1 if the union is not
+        //discriminated or its tag selects no member (all of them are visited). The union must have just been
+        //entered, the tag is peeked relative to it.
+        static int ActiveMember(const StructUnion & outer, const std::string & member, Visitor & visitor)
         {
-            Member m;
-            m.name = name;
-            m.type = type;
-            return visitMember(m, visitor);
+            auto found = outer.discriminators.find(member);
+            if (found == outer.discriminators.end())
+                return -1;
+            const auto & d = found->second;
+            unsigned long long raw = 0;
+            if (!visitor.peek(d.offset, d.size, raw))
+                return -1;
+            auto c = d.cases.find(integer(raw, d.size, d.isSigned));
+            return c != d.cases.end() ? c->second : d.fallback;
+        }
+
+        //Explicit stack of a visit in progress, so a visit can be suspended and resumed.
+        struct VisitState
+        {
+            enum Status
+            {
+                Running,
+                Waiting, //Visitor::ready returned false, call Resume again later
+                Suspended, //The VisitBudget was used up, call Resume again to continue
+                Done,
+                Failed, //The visitor aborted or a type is not defined
+                Cancelled //The CancelToken of the budget was set
+            };
+
+            Status status = Done;
+
+        private:
+            friend struct TypeManager;
+
+            struct Frame
+            {
+                enum Kind
+                {
+                    Start, //member not visited yet
+                    Pointer, //pointee visited, visitBack pending
+                    Members, //visiting the members of a struct/union
+                    Elements //visiting the elements of a counted pointee
+                };
+
+                Kind kind = Start;
+                const Member* member = nullptr; //nullptr for root and pointee members (stored in own)
+                Member own;
+                const StructUnion* type = nullptr;
+                size_t child = 0; //next member
+                size_t end = 0; //one past the last member to visit
+                int element = -1; //next element of the current array member, -1 outside arrays
+                const Member* array = nullptr; //array being visited, its arrsize may come from a count
+                bool pointee = false; //the member is the target of the parent frame
+                bool sized = false; //the last entry of VisitState::counted belongs to this frame (popped with it)
+
+                const Member & get() const
+                {
+                    return member ? *member : own;
+                }
+            };
+
+            std::vector<Frame> stack;
+            bool async = false;
+            const VisitFilter* filter = nullptr;
+            std::vector<const std::string*> path; //filter path of the current member
+            std::deque<Member> counted; //arrays sized during the visit (stable addresses), one per sized frame
+        };
+
+        //The filter (if any) has to outlive the visit
+        bool Visit(const std::string & name, const std::string & type, Visitor & visitor, const VisitFilter* filter = nullptr)
+        {
+            VisitState state;
+            begin(state, name, type, false, filter);
+            return Resume(state, visitor) == VisitState::Done;
+        }
+
+        //Prepares a visit to be run (possibly in slices) by Resume
+        void BeginVisit(VisitState & state, const std::string & name, const std::string & type, const VisitFilter* filter = nullptr)
+        {
+            begin(state, name, type, false, filter);
+        }
+
+        //Starts a visit that suspends whenever the visitor is not ready for the next member (see Visitor::ready)
+        VisitState::Status AsyncVisit(VisitState & state, const std::string & name, const std::string & type, Visitor & visitor, const VisitFilter* filter = nullptr)
+        {
+            begin(state, name, type, true, filter);
+            return Resume(state, visitor);
+        }
+
+        //Continues a visit until it completes, has to wait or used up the budget. The type system must not change meanwhile.
+        VisitState::Status Resume(VisitState & state, Visitor & visitor, const VisitBudget* budget = nullptr)
+        {
+            if (state.status != VisitState::Running && state.status != VisitState::Waiting && state.status != VisitState::Suspended)
+                return state.status;
+            state.status = VisitState::Running;
+            size_t nodes = 0;
+            size_t bytes = 0;
+            auto & stack = state.stack;
+            auto fail = [&state]()
+            {
+                state.stack.clear();
+                return state.status = VisitState::Failed;
+            };
+            while (!stack.empty())
+            {
+                auto & frame = stack.back();
+                const auto & member = frame.get();
+                if (frame.kind == VisitState::Frame::Start)
+                {
+                    auto foundT = types.find(member.type);
+                    if (state.filter && !accepted(state, foundT != types.end() && foundT->second.pointto.empty()))
+                    {
+                        stack.pop_back();
+                        continue;
+                    }
+                    if (budget)
+                    {
+                        if (budget->cancel && budget->cancel->Cancelled())
+                        {
+                            stack.clear();
+                            return state.status = VisitState::Cancelled;
+                        }
+                        if (nodes && ((budget->nodes && nodes >= budget->nodes) || (budget->bytes && bytes >= budget->bytes)))
+                            return state.status = VisitState::Suspended;
+                        if (nodes && !(nodes & 31) && VisitBudget::Clock::now() >= budget->deadline) //reading the clock is not free
+                            return state.status = VisitState::Suspended;
+                    }
+                    nodes++;
+                    if (foundT != types.end())
+                    {
+                        const auto & t = foundT->second;
+                        if (!t.pointto.empty() && !isDefined(t.pointto))
+                            return fail();
+                        auto pointeeSize = t.pointto.empty() ? 0 : Sizeof(t.pointto);
+                        if (state.async && !visitor.ready(member, &t, t.size, pointeeSize))
+                            return state.status = VisitState::Waiting;
+                        bytes += size_t(t.size);
+                        if (t.pointto.empty())
+                        {
+                            if (!visitor.visitType(member, t))
+                                return fail();
+                            stack.pop_back();
+                        }
+                        else
+                        {
+                            auto count = frame.member && stack.size() > 1 ? counted(stack[stack.size() - 2], member, visitor) : -1;
+                            if (!visitor.visitPtr(member, t, pointeeSize)) //allow the visitor to bail out
+                            {
+                                stack.pop_back();
+                                continue;
+                            }
+                            frame.kind = VisitState::Frame::Pointer;
+                            VisitState::Frame pointee;
+                            pointee.pointee = true;
+                            if (count < 0)
+                            {
+                                pointee.own.name = "*" + member.name;
+                                pointee.own.type = t.pointto;
+                                dynamicType(pointee.own, visitor);
+                                stack.push_back(pointee);
+                                continue;
+                            }
+                            state.counted.push_back(Member());
+                            frame.sized = true;
+                            auto & elements = state.counted.back();
+                            elements.name = "*" + member.name;
+                            elements.type = t.pointto;
+                            elements.arrsize = count;
+                            auto action = visitor.visitArray(elements);
+                            if (action == Abort)
+                                return fail();
+                            if (action == Continue)
+                            {
+                                pointee.kind = VisitState::Frame::Elements;
+                                pointee.member = &elements;
+                                pointee.element = 0;
+                                stack.push_back(pointee);
+                            }
+                        }
+                        continue;
+                    }
+                    auto foundS = structs.find(member.type);
+                    if (foundS == structs.end())
+                        return fail();
+                    const auto & s = foundS->second;
+                    if (state.async && !visitor.ready(member, nullptr, s.size, 0))
+                        return state.status = VisitState::Waiting;
+                    auto action = visitor.visitStructUnion(member, s);
+                    if (action == Abort)
+                        return fail();
+                    if (action == Skip)
+                    {
+                        stack.pop_back();
+                        continue;
+                    }
+                    frame.kind = VisitState::Frame::Members;
+                    frame.type = &s;
+                    frame.end = s.members.size();
+                    if (s.isunion && frame.member && stack.size() > 1)
+                        discriminate(stack[stack.size() - 2], frame, visitor);
+                }
+                else if (frame.kind == VisitState::Frame::Elements)
+                {
+                    if (frame.element < member.arrsize)
+                    {
+                        frame.element++;
+                        auto element = start(&member);
+                        element.pointee = true;
+                        stack.push_back(element);
+                        continue;
+                    }
+                    if (!visitor.visitBack(member))
+                        return fail();
+                    stack.pop_back();
+                }
+                else if (frame.kind == VisitState::Frame::Pointer)
+                {
+                    if (!visitor.visitBack(member))
+                        return fail();
+                    if (frame.sized)
+                        state.counted.pop_back();
+                    stack.pop_back();
+                }
+                else if (frame.element >= 0)
+                {
+                    const auto & child = frame.type->members[frame.child];
+                    if (frame.element < frame.array->arrsize)
+                    {
+                        frame.element++;
+                        stack.push_back(start(&child));
+                        continue;
+                    }
+                    if (!visitor.visitBack(*frame.array))
+                        return fail();
+                    unsize(state, frame);
+                    frame.element = -1;
+                    frame.child++;
+                }
+                else if (frame.child < frame.end)
+                {
+                    const auto & child = frame.type->members[frame.child];
+                    if (child.arrsize)
+                    {
+                        if (state.filter && !accepted(state, isLeaf(child.type), &child))
+                        {
+                            frame.child++;
+                            continue;
+                        }
+                        frame.array = &child;
+                        auto count = counted(frame, child, visitor);
+                        if (count >= 0)
+                        {
+                            state.counted.push_back(child);
+                            state.counted.back().arrsize = count;
+                            frame.array = &state.counted.back();
+                            frame.sized = true;
+                        }
+                        auto action = visitor.visitArray(*frame.array);
+                        if (action == Abort)
+                            return fail();
+                        if (action == Skip)
+                        {
+                            unsize(state, frame);
+                            frame.child++;
+                        }
+                        else
+                            frame.element = 0;
+                        continue;
+                    }
+                    frame.child++;
+                    stack.push_back(start(&child));
+                }
+                else
+                {
+                    if (!visitor.visitBack(member))
+                        return fail();
+                    stack.pop_back();
+                }
+            }
+            return state.status = VisitState::Done;
         }
 
         void Clear(const std::string & owner = "")
         {
             laststruct.clear();
             lastfunction.clear();
+            lastenum.clear();
+            layouts.clear();
+            filterOwnerMap(enums, owner);
             filterOwnerMap(types, owner);
             filterOwnerMap(structs, owner);
             filterOwnerMap(functions, owner);
+            filterOwnerMap(vtables, owner);
         }
 
     private:
@@ -250,8 +1130,12 @@ namespace Types
         std::unordered_map<std::string, Type> types;
         std::unordered_map<std::string, StructUnion> structs;
         std::unordered_map<std::string, Function> functions;
+        std::unordered_map<std::string, Layout> layouts;
+        std::unordered_map<std::string, Enum> enums;
+        std::unordered_map<unsigned long long, Vtable> vtables;
         std::string laststruct;
         std::string lastfunction;
+        std::string lastenum;
 
         template<typename K, typename V>
         void filterOwnerMap(std::unordered_map<K ,V> & map, const std::string & owner)
@@ -301,7 +1185,7 @@ namespace Types
             p("int8_t,int8,char,byte,bool,signed char", Int8, sizeof(char));
             p("uint8_t,uint8,uchar,unsigned char,ubyte", Uint8, sizeof(unsigned char));
             p("int16_t,int16,wchar_t,char16_t,short", Int16, sizeof(short));
-            p("uint16_t,uint16,ushort,unsigned short", Int16, sizeof(unsigned short));
+            p("uint16_t,uint16,ushort,unsigned short", Uint16, sizeof(unsigned short));
             p("int32_t,int32,int,long", Int32, sizeof(int));
             p("uint32_t,uint32,unsigned int,unsigned long", Uint32, sizeof(unsigned int));
             p("int64_t,int64,long long", Int64, sizeof(long long));
@@ -321,6 +1205,104 @@ namespace Types
             return map.find(k) != map.end();
         }
 
+        //Restricts the members of a union frame to the active one if its enclosing struct has a tag for it
+        static void discriminate(const VisitState::Frame & outer, VisitState::Frame & frame, Visitor & visitor)
+        {
+            if (outer.kind != VisitState::Frame::Members || outer.type->discriminators.empty())
+                return;
+            auto index = ActiveMember(*outer.type, frame.member->name, visitor);
+            if (index < 0)
+                return;
+            frame.child = size_t(index);
+            frame.end = frame.child + 1;
+        }
+
+        //Element count of a counted member of the struct frame, -1 if it has none or it cannot be read
+        static int counted(const VisitState::Frame & outer, const Member & member, Visitor & visitor)
+        {
+            if (outer.kind != VisitState::Frame::Members || outer.type->counts.empty())
+                return -1;
+            auto found = outer.type->counts.find(member.name);
+            if (found == outer.type->counts.end())
+                return -1;
+            const auto & c = found->second;
+            unsigned long long raw = 0;
+            if (!visitor.peek(c.offset, c.size, raw))
+                return -1;
+            auto count = c.isSigned ? integer(raw, c.size, true) : (long long)(raw > (unsigned long long)c.maxcount ? c.maxcount : raw);
+            return count < 0 ? 0 : count > c.maxcount ? c.maxcount : int(count);
+        }
+
+        static long long integer(unsigned long long raw, int size, bool isSigned)
+        {
+            if (!isSigned || size >= 8)
+                return (long long)raw;
+            auto shift = 64 - size * 8;
+            return (long long)(raw << shift) >> shift;
+        }
+
+        void markPolymorphic(StructUnion & s)
+        {
+            s.polymorphic = true;
+            for (const auto & m : s.members)
+            {
+                auto found = m.isbase ? structs.find(m.type) : structs.end();
+                if (found != structs.end() && !found->second.polymorphic)
+                    markPolymorphic(found->second);
+            }
+        }
+
+        //Replaces the declared type of a followed pointee by the most-derived type its vptr points to. The
+        //negative offset makes the visitor start at the derived object when the pointer is to a secondary base.
+        void dynamicType(Member & pointee, Visitor & visitor) const
+        {
+            if (vtables.empty())
+                return;
+            auto foundS = structs.find(pointee.type);
+            if (foundS == structs.end() || !foundS->second.polymorphic)
+                return;
+            unsigned long long vptr = 0;
+            if (!visitor.peek(0, primitivesizes.at(Pointer), vptr))
+                return;
+            auto found = vtables.find(vptr);
+            if (found == vtables.end())
+                return;
+            pointee.type = found->second.type;
+            pointee.offset = -found->second.offset;
+        }
+
+        static const Member* findMember(const StructUnion & s, const std::string & name)
+        {
+            for (const auto & m : s.members)
+                if (m.name == name)
+                    return &m;
+            return nullptr;
+        }
+
+        static int memberIndex(const StructUnion & s, const std::string & name)
+        {
+            for (size_t i = 0; i < s.members.size(); i++)
+                if (s.members[i].name == name)
+                    return int(i);
+            return -1;
+        }
+
+        static bool isInteger(Primitive p)
+        {
+            return p == Int8 || p == Uint8 || p == Int16 || p == Uint16 || p == Int32 || p == Uint32 || p == Int64 || p == Uint64 || p == Dsint || p == Duint;
+        }
+
+        static bool isSignedInteger(Primitive p)
+        {
+            return p == Int8 || p == Int16 || p == Int32 || p == Int64 || p == Dsint;
+        }
+
+        bool isLeaf(const std::string & id) const
+        {
+            auto found = types.find(id);
+            return found != types.end() && found->second.pointto.empty();
+        }
+
         bool isDefined(const std::string & id) const
         {
             return mapContains(types, id) || mapContains(structs, id);
@@ -362,50 +1344,88 @@ namespace Types
             return true;
         }
 
-        bool visitMember(const Member & root, Visitor & visitor)
+        void flatten(const std::string & type, const std::string & path, int offset, std::vector<Field> & fields, const Member* member = nullptr)
         {
-            auto foundT = types.find(root.type);
+            auto foundT = types.find(type);
             if (foundT != types.end())
             {
-                const auto & t = foundT->second;
-                if (!t.pointto.empty())
+                Field f;
+                f.path = path;
+                f.type = type;
+                f.primitive = foundT->second.primitive;
+                f.offset = offset;
+                f.size = foundT->second.size;
+                if (member)
                 {
-                    if (!isDefined(t.pointto))
-                        return false;
-                    if (visitor.visitPtr(root, t)) //allow the visitor to bail out
-                    {
-                        if (!Visit("*" + root.name, t.pointto, visitor))
-                            return false;
-                        return visitor.visitBack(root);
-                    }
-                    return true;
+                    f.bitoffset = member->bitoffset;
+                    f.bitsize = member->bitsize;
                 }
-                return visitor.visitType(root, t);
+                fields.push_back(f);
+                return;
             }
-            auto foundS = structs.find(root.type);
-            if (foundS != structs.end())
+            auto foundS = structs.find(type);
+            if (foundS == structs.end())
+                return;
+            for (const auto & child : foundS->second.members)
             {
-                const auto & s = foundS->second;
-                if (!visitor.visitStructUnion(root, s))
-                    return false;
-                for (const auto & child : s.members)
+                auto childPath = path.empty() ? child.name : path + "." + child.name;
+                auto childOffset = offset + child.offset;
+                if (child.arrsize)
                 {
-                    if (child.arrsize)
+                    auto size = Sizeof(child.type);
+                    char index[32] = "";
+                    for (auto i = 0; i < child.arrsize; i++)
                     {
-                        if (!visitor.visitArray(child))
-                            return false;
-                        for (auto i = 0; i < child.arrsize; i++)
-                            if (!visitMember(child, visitor))
-                                return false;
-                        if (!visitor.visitBack(child))
-                            return false;
+                        sprintf_s(index, "[%d]", i);
+                        flatten(child.type, childPath + index, childOffset + i * size, fields);
                     }
-                    else if (!visitMember(child, visitor))
-                        return false;
                 }
-                return visitor.visitBack(root);
+                else
+                    flatten(child.type, childPath, childOffset, fields, &child);
             }
-            return false;
+        }
+
+        //Whether the filter accepts the member of the top frame (or child, a member of the top frame)
+        bool accepted(VisitState & state, bool leaf, const Member* child = nullptr)
+        {
+            auto & path = state.path;
+            path.clear();
+            const auto & stack = state.stack;
+            for (size_t i = 1; i < stack.size(); i++)
+                if (!stack[i].pointee)
+                    path.push_back(&stack[i].get().name);
+            if (child)
+                path.push_back(&child->name);
+            return state.filter->Accept(path, leaf);
+        }
+
+        void begin(VisitState & state, const std::string & name, const std::string & type, bool async, const VisitFilter* filter)
+        {
+            VisitState::Frame root;
+            root.own.name = name;
+            root.own.type = type;
+            state.stack.clear();
+            state.stack.push_back(root);
+            state.async = async;
+            state.filter = filter;
+            state.counted.clear();
+            state.status = VisitState::Running;
+        }
+
+        //Releases the counted array of a struct frame once its elements are done
+        static void unsize(VisitState & state, VisitState::Frame & frame)
+        {
+            if (!frame.sized)
+                return;
+            state.counted.pop_back();
+            frame.sized = false;
+        }
+
+        static VisitState::Frame start(const Member* member)
+        {
+            VisitState::Frame frame;
+            frame.member = member;
+            return frame;
         }
     };
 };
\ No newline at end of file
@@ -0,0 +1,831 @@
+#pragma once
+
+#include "Types.h"
+#include "Memory.h"
+#include "Strings.h"
+#include "Bitfields.h"
+#include "Symbols.h"
+#include <cstdio>
+#include <cstring>
+
+namespace Types
+{
+    //Visitor base that tracks where the visited data lives (offset, pointers, arrays) and hands out the raw values.
+    struct DataVisitor : TypeManager::Visitor
+    {
+        explicit DataVisitor(void* data = nullptr, int maxPtrDepth = 0)
+            : mData(data), mMaxPtrDepth(maxPtrDepth) { }
+
+        //Memory the data is read from, by default the current process (validated against its mappings)
+        void SetReader(MemoryReader* reader)
+        {
+            mReader = reader;
+        }
+
+        //Shared string reader (and cache) for String/WString members, by default an uncached one over the reader
+        void SetStringReader(StringReader* strings)
+        {
+            mStrings = strings;
+        }
+
+        bool visitType(const Member & member, const Type & type) override
+        {
+            enterChild(member, type.size);
+            auto value = readValue(type.size);
+            if (member.bitsize)
+            {
+                value = BitfieldDecoder::Extract(value, member.bitoffset, member.bitsize, isSigned(type.primitive));
+                if (type.size < 8)
+                    value &= (1ULL << (type.size * 8)) - 1; //raw bits of the member type like other values
+            }
+            auto res = onValue(member, type, value);
+            mOffset += type.size;
+            return res;
+        }
+
+        VisitAction visitStructUnion(const Member & member, const StructUnion & type) override
+        {
+            enterChild(member, type.size);
+            if (!onStructUnion(member, type))
+                return Abort;
+            mParents.push_back(Parent(type.isunion ? Parent::Union : Parent::Struct));
+            parent().start = mOffset;
+            parent().size = type.size;
+            parent().layout = &type;
+            return Continue;
+        }
+
+        VisitAction visitArray(const Member & member) override
+        {
+            enterChild(member, 0);
+            if (!onArray(member))
+                return Abort;
+            mParents.push_back(Parent(Parent::Array));
+            parent().start = mOffset;
+            return Continue;
+        }
+
+        bool visitPtr(const Member & member, const Type & type, int pointeeSize) override
+        {
+            enterChild(member, type.size);
+            auto value = readValue(type.size);
+            auto follow = mPtrDepth < mMaxPtrDepth && mData && reader().IsValid(duint(value), pointeeSize > 0 ? size_t(pointeeSize) : 1);
+            auto res = onPointer(member, type, value, follow);
+            mOffset += type.size;
+            if (!res || !follow)
+                return false;
+            mParents.push_back(Parent(Parent::Pointer));
+            parent().offset = mOffset;
+            parent().data = mData;
+            mOffset = 0;
+            mData = (void*)value;
+            mPtrDepth++;
+            return true;
+        }
+
+        bool visitBack(const Member & member) override
+        {
+            auto kind = parent().type;
+            if (kind == Parent::Pointer)
+            {
+                mOffset = parent().offset;
+                mData = parent().data;
+                mPtrDepth--;
+            }
+            else if (kind != Parent::Array)
+                mOffset = parent().start + parent().size;
+            mParents.pop_back();
+            return onBack(member, kind);
+        }
+
+        bool peek(int offset, int size, unsigned long long & value) override
+        {
+            value = 0;
+            if (!mData || mParents.empty() || size <= 0 || size > 8)
+                return false;
+            auto base = parent().type == Parent::Pointer ? 0 : parent().start;
+            return reader().Read(duint(mData) + base + offset, &value, size_t(size));
+        }
+
+        //Prefetches the member (and the string or pointee it refers to) through the reader
+        bool ready(const Member & member, const Type* type, int size, int pointeeSize) override
+        {
+            if (!mData || size <= 0)
+                return true;
+            auto address = duint(mData) + childOffset(member, size);
+            auto & reader = this->reader();
+            if (!reader.Prefetch(address, size_t(size)))
+                return false;
+            if (!type)
+                return true;
+            size_t target = 0;
+            if (type->primitive == String)
+                target = strings().MaxLength() + 1;
+            else if (type->primitive == WString)
+                target = (strings().MaxLength() + 1) * reader.WideCharSize();
+            else if (!type->pointto.empty() && mPtrDepth < mMaxPtrDepth)
+                target = pointeeSize > 0 ? size_t(pointeeSize) : 1; //the range visitPtr validates before following
+            duint value = 0;
+            if (!target || !reader.Read(address, &value, size_t(size) < sizeof(value) ? size_t(size) : sizeof(value)) || !value)
+                return true;
+            return reader.Prefetch(value, target);
+        }
+
+    protected:
+        struct Parent
+        {
+            enum Type
+            {
+                Struct,
+                Union,
+                Array,
+                Pointer
+            };
+
+            Type type;
+            int index = 0;
+            void* data = nullptr;
+            int offset = 0;
+            int start = 0;
+            int size = 0;
+            const StructUnion* layout = nullptr; //Struct or union being visited
+
+            explicit Parent(Type type)
+                : type(type) { }
+        };
+
+        //value holds the raw (little endian) bits of the member, zero-extended to 64 bits
+        virtual bool onValue(const Member & member, const Type & type, unsigned long long value) = 0;
+        virtual bool onStructUnion(const Member & member, const StructUnion & type) = 0;
+        virtual bool onArray(const Member & member) = 0;
+        virtual bool onBack(const Member & member, Parent::Type kind) = 0;
+
+        //follow is true when the pointee will be visited next (closed by onBack with Parent::Pointer)
+        virtual bool onPointer(const Member & member, const Type & type, unsigned long long value, bool follow)
+        {
+            return onValue(member, type, value);
+        }
+
+        Parent & parent()
+        {
+            return mParents[mParents.size() - 1];
+        }
+
+        bool inside(Parent::Type type) const
+        {
+            return !mParents.empty() && mParents[mParents.size() - 1].type == type;
+        }
+
+        static long long signExtend(unsigned long long value, int size)
+        {
+            if (size <= 0 || size >= 8)
+                return (long long)value;
+            auto shift = 64 - size * 8;
+            return (long long)(value << shift) >> shift;
+        }
+
+        static bool isSigned(Primitive primitive)
+        {
+            return primitive == Int8 || primitive == Int16 || primitive == Int32 || primitive == Int64 || primitive == Dsint;
+        }
+
+        //Reads the String/WString a member points to as UTF-8 (fails if the pointer is not readable)
+        bool readUtf8(const Type & type, unsigned long long value, std::string & str)
+        {
+            str.clear();
+            auto & strings = this->strings();
+            if (type.primitive == String)
+                return strings.Read(duint(value), 1, str);
+            auto charSize = reader().WideCharSize();
+            if (!strings.Read(duint(value), charSize, mRaw))
+                return false;
+            Utf8::Append((const unsigned char*)mRaw.data(), mRaw.size() / charSize, charSize, str);
+            return true;
+        }
+
+        MemoryReader & reader()
+        {
+            return mReader ? *mReader : mLocal;
+        }
+
+        StringReader & strings()
+        {
+            if (mStrings)
+                return *mStrings;
+            mLocalStrings.SetReader(&reader());
+            return mLocalStrings;
+        }
+
+        std::vector<Parent> mParents;
+        int mOffset = 0;
+        int mIndex = -1; //index of the current element if the parent is an array
+        void* mData = nullptr;
+        int mPtrDepth = 0;
+        int mMaxPtrDepth = 0;
+        std::string mStr;
+        std::string mRaw;
+
+    private:
+        MemoryReader* mReader = nullptr;
+        LocalMemoryReader mLocal;
+        StringReader* mStrings = nullptr;
+        StringReader mLocalStrings = StringReader(nullptr, 255, 0);
+
+        //Offset of the next member (or array element of size bytes). Positions come from the member offsets,
+        //so members left out of the visit (filters, skipped subtrees) do not shift the ones after them.
+        int childOffset(const Member & member, int size)
+        {
+            if (mParents.empty())
+                return mOffset;
+            const auto & p = parent();
+            if (p.type == Parent::Struct || p.type == Parent::Union)
+                return p.start + member.offset;
+            if (p.type == Parent::Array)
+                return p.start + p.index * size;
+            return mOffset + member.offset; //pointee, negative for a pointer to a secondary base
+        }
+
+        void enterChild(const Member & member, int size)
+        {
+            mOffset = childOffset(member, size);
+            mIndex = inside(Parent::Array) ? parent().index++ : -1;
+        }
+
+        unsigned long long readValue(int size)
+        {
+            unsigned long long value = 0;
+            if (mData && size > 0)
+                reader().Read(duint(mData) + mOffset, &value, size_t(size > 8 ? 8 : size));
+            return value;
+        }
+    };
+
+    struct PrintVisitor : DataVisitor
+    {
+        explicit PrintVisitor(void* data = nullptr, int maxPtrDepth = 0)
+            : DataVisitor(data, maxPtrDepth) { }
+
+        //Pointers into a symbol are printed with symbol+offset
+        void SetSymbols(const SymbolIndex* symbols)
+        {
+            mSymbols = symbols;
+        }
+
+    protected:
+        bool onValue(const Member & member, const Type & type, unsigned long long value) override
+        {
+            print(member, type, value, false);
+            return true;
+        }
+
+        bool onPointer(const Member & member, const Type & type, unsigned long long value, bool follow) override
+        {
+            print(member, type, value, follow);
+            return true;
+        }
+
+        bool onStructUnion(const Member & member, const StructUnion & type) override
+        {
+            indent();
+            printf("%s %s {\n", type.isunion ? "union" : "struct", type.name.c_str());
+            return true;
+        }
+
+        bool onArray(const Member & member) override
+        {
+            indent();
+            printf("%s[%d] {\n", member.type.c_str(), member.arrsize);
+            return true;
+        }
+
+        bool onBack(const Member & member, Parent::Type kind) override
+        {
+            indent();
+            printf("} %s;\n", member.name.c_str());
+            return true;
+        }
+
+    private:
+        void print(const Member & member, const Type & type, unsigned long long value, bool follow)
+        {
+            char valueStr[64] = "";
+            switch (type.primitive)
+            {
+            case Pointer:
+                sprintf_s(valueStr, "0x%p", (void*)value);
+                break;
+            case String:
+            case WString:
+                if (readUtf8(type, value, mStr))
+                    mStr = (type.primitive == WString ? "L\"" : "\"") + mStr + "\"";
+                else
+                {
+                    sprintf_s(valueStr, "0x%p", (void*)value);
+                    mStr = std::string(valueStr) + " (invalid)";
+                }
+                break;
+            default:
+                sprintf_s(valueStr, "0x%llX", value);
+                break;
+            }
+            auto named = false;
+            if (type.primitive == Pointer && mSymbols)
+            {
+                mStr = valueStr;
+                mStr += " <";
+                named = mSymbols->Format(value, mStr);
+                mStr += ">";
+            }
+            else if (type.enumeration)
+            {
+                mStr.clear();
+                named = type.enumeration->Format(value, mStr);
+                if (named)
+                    mStr = mStr + " (" + valueStr + ")";
+            }
+            auto str = named || type.primitive == String || type.primitive == WString ? mStr.c_str() : valueStr;
+            indent();
+            if (mIndex >= 0)
+                printf("%s %s[%d] = %s;", type.name.c_str(), member.name.c_str(), mIndex, str);
+            else if (member.bitsize)
+                printf("%s %s : %d = %s;", type.name.c_str(), member.name.c_str(), member.bitsize, str);
+            else
+                printf("%s %s = %s;", type.name.c_str(), member.name.c_str(), str);
+            puts(follow ? " {" : "");
+        }
+
+        void indent() const
+        {
+            printf("%p:%02d: ", mData, mOffset);
+            for (auto i = 0; i < int(mParents.size()) * 2; i++)
+                printf(" ");
+        }
+
+        const SymbolIndex* mSymbols = nullptr;
+    };
+
+    //Fixed-capacity output: writes past the end are dropped but still counted (like snprintf).
+    struct OutputBuffer
+    {
+        explicit OutputBuffer(void* data = nullptr, size_t capacity = 0)
+            : mData((unsigned char*)data), mCapacity(capacity) { }
+
+        void Put(unsigned char ch)
+        {
+            if (mSize < mCapacity)
+                mData[mSize] = ch;
+            mSize++;
+        }
+
+        void Write(const void* data, size_t size)
+        {
+            if (mSize < mCapacity)
+                memcpy(mData + mSize, data, size < mCapacity - mSize ? size : mCapacity - mSize);
+            mSize += size;
+        }
+
+        void Write(const char* str)
+        {
+            Write(str, strlen(str));
+        }
+
+        //NUL-terminate the output without counting the terminator
+        void Terminate()
+        {
+            if (mSize < mCapacity)
+                mData[mSize] = '\0';
+            else if (mCapacity)
+                mData[mCapacity - 1] = '\0';
+        }
+
+        size_t Size() const { return mSize; } //Bytes required for the complete output
+        bool Overflow() const { return mSize > mCapacity; }
+
+    private:
+        unsigned char* mData;
+        size_t mCapacity;
+        size_t mSize = 0;
+    };
+
+    //Structured output visitor base: owns the output buffer and decodes strings for the concrete formats.
+    struct SerializeVisitor : DataVisitor
+    {
+        SerializeVisitor(void* buffer, size_t capacity, void* data, int maxPtrDepth)
+            : DataVisitor(data, maxPtrDepth), mOut(buffer, capacity) { }
+
+        size_t Size() const { return mOut.Size(); }
+        bool Overflow() const { return mOut.Overflow(); }
+
+    protected:
+        OutputBuffer mOut;
+
+        static double toDouble(const Type & type, unsigned long long value)
+        {
+            if (type.primitive == Float)
+            {
+                float f;
+                auto bits = (unsigned int)value;
+                memcpy(&f, &bits, sizeof(f));
+                return f;
+            }
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            return d;
+        }
+    };
+
+    //Renders the instance as JSON. Structs/unions are objects, arrays are arrays and a followed
+    //pointer becomes {"address": "0x...", "target": <pointee>}. Enum values with a name become strings.
+    struct JsonVisitor : SerializeVisitor
+    {
+        JsonVisitor(void* buffer, size_t capacity, void* data = nullptr, int maxPtrDepth = 0)
+            : SerializeVisitor(buffer, capacity, data, maxPtrDepth) { }
+
+    protected:
+        bool onValue(const Member & member, const Type & type, unsigned long long value) override
+        {
+            key(member);
+            char num[32] = "";
+            switch (type.primitive)
+            {
+            case Float:
+            case Double:
+            {
+                auto d = toDouble(type, value);
+                if (d != d || d - d != 0) //NaN and infinity are not valid JSON
+                    mOut.Write("null");
+                else
+                {
+                    sprintf_s(num, "%.17g", d);
+                    mOut.Write(num);
+                }
+            }
+            break;
+            case Pointer:
+                sprintf_s(num, "\"0x%llX\"", value);
+                mOut.Write(num);
+                break;
+            case String:
+            case WString:
+                if (readUtf8(type, value, mStr))
+                    string(mStr);
+                else
+                    mOut.Write("null");
+                break;
+            default:
+                mStr.clear();
+                if (type.enumeration && type.enumeration->Format(value, mStr))
+                    string(mStr);
+                else
+                {
+                    if (isSigned(type.primitive))
+                        sprintf_s(num, "%lld", signExtend(value, type.size));
+                    else
+                        sprintf_s(num, "%llu", value);
+                    mOut.Write(num);
+                }
+                break;
+            }
+            return done();
+        }
+
+        bool onPointer(const Member & member, const Type & type, unsigned long long value, bool follow) override
+        {
+            if (!follow)
+                return onValue(member, type, value);
+            key(member);
+            char num[32] = "";
+            sprintf_s(num, "{\"address\":\"0x%llX\"", value);
+            mOut.Write(num);
+            mComma = true;
+            return true;
+        }
+
+        bool onStructUnion(const Member & member, const StructUnion & type) override
+        {
+            key(member);
+            mOut.Put('{');
+            mComma = false;
+            return true;
+        }
+
+        bool onArray(const Member & member) override
+        {
+            key(member);
+            mOut.Put('[');
+            mComma = false;
+            return true;
+        }
+
+        bool onBack(const Member & member, Parent::Type kind) override
+        {
+            mOut.Put(kind == Parent::Array ? ']' : '}');
+            return done();
+        }
+
+    private:
+        bool mComma = false;
+
+        void key(const Member & member)
+        {
+            if (mComma)
+                mOut.Put(',');
+            if (mParents.empty() || inside(Parent::Array))
+                return;
+            if (inside(Parent::Pointer))
+                mOut.Write("\"target\":");
+            else
+            {
+                string(member.name);
+                mOut.Put(':');
+            }
+        }
+
+        bool done()
+        {
+            mComma = true;
+            if (mParents.empty())
+                mOut.Terminate();
+            return true;
+        }
+
+        void string(const std::string & str)
+        {
+            static const char hex[] = "0123456789abcdef";
+            mOut.Put('"');
+            for (auto ch : str)
+            {
+                auto uch = (unsigned char)ch;
+                if (uch == '"' || uch == '\\')
+                {
+                    mOut.Put('\\');
+                    mOut.Put(uch);
+                }
+                else if (uch < 0x20)
+                {
+                    char esc[] = { '\\', 'u', '0', '0', hex[uch >> 4], hex[uch & 0xF] };
+                    mOut.Write(esc, sizeof(esc));
+                }
+                else
+                    mOut.Put(uch);
+            }
+            mOut.Put('"');
+        }
+    };
+
+    //Renders the instance as CBOR (RFC 7049) with the same shape as JsonVisitor. Arrays have definite lengths,
+    //structs/unions are indefinite-length maps since a filtered visit leaves out members.
+    struct CborVisitor : SerializeVisitor
+    {
+        CborVisitor(void* buffer, size_t capacity, void* data = nullptr, int maxPtrDepth = 0)
+            : SerializeVisitor(buffer, capacity, data, maxPtrDepth) { }
+
+    protected:
+        enum Major
+        {
+            UnsignedInt = 0,
+            NegativeInt = 1,
+            TextString = 3,
+            Array = 4,
+            Map = 5,
+            Simple = 7
+        };
+
+        bool onValue(const Member & member, const Type & type, unsigned long long value) override
+        {
+            key(member);
+            switch (type.primitive)
+            {
+            case Float:
+            {
+                auto bits = (unsigned int)value;
+                mOut.Put(0xFA);
+                for (auto i = 3; i >= 0; i--)
+                    mOut.Put((unsigned char)(bits >> (i * 8)));
+            }
+            break;
+            case Double:
+                mOut.Put(0xFB);
+                for (auto i = 7; i >= 0; i--)
+                    mOut.Put((unsigned char)(value >> (i * 8)));
+                break;
+            case String:
+            case WString:
+                if (readUtf8(type, value, mStr))
+                    text(mStr);
+                else
+                    mOut.Put(0xF6); //null
+                break;
+            default:
+                mStr.clear();
+                if (type.enumeration && type.enumeration->Format(value, mStr))
+                    text(mStr);
+                else if (isSigned(type.primitive))
+                {
+                    auto s = signExtend(value, type.size);
+                    if (s < 0)
+                        head(NegativeInt, (unsigned long long)(-1 - s));
+                    else
+                        head(UnsignedInt, (unsigned long long)s);
+                }
+                else
+                    head(UnsignedInt, value);
+                break;
+            }
+            return true;
+        }
+
+        bool onPointer(const Member & member, const Type & type, unsigned long long value, bool follow) override
+        {
+            if (!follow)
+                return onValue(member, type, value);
+            key(member);
+            head(Map, 2);
+            text("address");
+            head(UnsignedInt, value);
+            return true;
+        }
+
+        bool onStructUnion(const Member & member, const StructUnion & type) override
+        {
+            key(member);
+            mOut.Put(0xBF); //indefinite-length map
+            return true;
+        }
+
+        bool onArray(const Member & member) override
+        {
+            key(member);
+            head(Array, (unsigned long long)member.arrsize);
+            return true;
+        }
+
+        bool onBack(const Member & member, Parent::Type kind) override
+        {
+            if (kind == Parent::Struct || kind == Parent::Union)
+                mOut.Put(0xFF); //break
+            return true;
+        }
+
+    private:
+        void key(const Member & member)
+        {
+            if (mParents.empty() || inside(Parent::Array))
+                return;
+            if (inside(Parent::Pointer))
+                text("target");
+            else
+                text(member.name);
+        }
+
+        void head(Major major, unsigned long long value)
+        {
+            auto m = (unsigned char)(major << 5);
+            if (value < 24)
+                mOut.Put(m | (unsigned char)value);
+            else if (value <= 0xFF)
+            {
+                mOut.Put(m | 24);
+                mOut.Put((unsigned char)value);
+            }
+            else if (value <= 0xFFFF)
+            {
+                mOut.Put(m | 25);
+                mOut.Put((unsigned char)(value >> 8));
+                mOut.Put((unsigned char)value);
+            }
+            else if (value <= 0xFFFFFFFF)
+            {
+                mOut.Put(m | 26);
+                for (auto i = 3; i >= 0; i--)
+                    mOut.Put((unsigned char)(value >> (i * 8)));
+            }
+            else
+            {
+                mOut.Put(m | 27);
+                for (auto i = 7; i >= 0; i--)
+                    mOut.Put((unsigned char)(value >> (i * 8)));
+            }
+        }
+
+        void text(const std::string & str)
+        {
+            head(TextString, str.size());
+            mOut.Write(str.data(), str.size());
+        }
+    };
+
+    //Schema-driven compact binary: no names or tags, the reader walks the same type to decode.
+    //Integers are LEB128 varints (zigzag for signed), Float/Double are raw little endian,
+    //strings are varint(length + 1) followed by UTF-8 (0 means null) and typed pointers
+    //are followed by a byte that is 1 if the pointee follows.
+    //Members with an element count (AddCount) are preceded by varint(count), a followed counted pointer
+    //writes it after the presence byte. Discriminated unions (AddDiscriminator) are preceded by
+    //varint(index + 1) of the active member, 0 if all members follow.
+    struct BinaryVisitor : SerializeVisitor
+    {
+        BinaryVisitor(void* buffer, size_t capacity, void* data = nullptr, int maxPtrDepth = 0)
+            : SerializeVisitor(buffer, capacity, data, maxPtrDepth) { }
+
+        VisitAction visitStructUnion(const Member & member, const StructUnion & type) override
+        {
+            auto outer = mParents.empty() ? nullptr : parent().layout;
+            auto action = SerializeVisitor::visitStructUnion(member, type);
+            if (action == Continue && outer && type.isunion && outer->discriminators.count(member.name))
+                varint((unsigned long long)(TypeManager::ActiveMember(*outer, member.name, *this) + 1));
+            return action;
+        }
+
+    protected:
+        bool onValue(const Member & member, const Type & type, unsigned long long value) override
+        {
+            pointee();
+            switch (type.primitive)
+            {
+            case Float:
+            case Double:
+                for (auto i = 0; i < type.size; i++)
+                    mOut.Put((unsigned char)(value >> (i * 8)));
+                break;
+            case String:
+            case WString:
+                if (readUtf8(type, value, mStr))
+                {
+                    varint(mStr.size() + 1);
+                    mOut.Write(mStr.data(), mStr.size());
+                }
+                else
+                    varint(0);
+                break;
+            default:
+                if (isSigned(type.primitive))
+                {
+                    auto s = signExtend(value, type.size);
+                    varint((unsigned long long)(s << 1) ^ (unsigned long long)(s >> 63));
+                }
+                else
+                    varint(value);
+                break;
+            }
+            return true;
+        }
+
+        bool onPointer(const Member & member, const Type & type, unsigned long long value, bool follow) override
+        {
+            pointee();
+            varint(value);
+            mOut.Put(follow ? 1 : 0);
+            mCountPending = follow && counted(member);
+            return true;
+        }
+
+        bool onStructUnion(const Member & member, const StructUnion & type) override
+        {
+            pointee();
+            return true;
+        }
+
+        bool onArray(const Member & member) override
+        {
+            if (mCountPending || counted(member))
+                varint((unsigned long long)member.arrsize);
+            mCountPending = false;
+            return true;
+        }
+
+        bool onBack(const Member & member, Parent::Type kind) override
+        {
+            return true;
+        }
+
+    private:
+        bool mCountPending = false; //a counted pointer was followed, its elements come next
+
+        //The element count of member comes from a sibling in the struct being visited
+        bool counted(const Member & member)
+        {
+            if (mParents.empty() || !parent().layout)
+                return false;
+            return parent().layout->counts.count(member.name) != 0;
+        }
+
+        //The count of a counted pointer could not be read, its single pointee is written as one element
+        void pointee()
+        {
+            if (!mCountPending)
+                return;
+            mCountPending = false;
+            varint(1);
+        }
+
+        void varint(unsigned long long value)
+        {
+            while (value >= 0x80)
+            {
+                mOut.Put((unsigned char)(value | 0x80));
+                value >>= 7;
+            }
+            mOut.Put((unsigned char)value);
+        }
+    };
+};
\ No newline at end of file